@@ -0,0 +1,151 @@
+#include "assetpool.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+
+QByteArray AssetPool::internTiles(QByteArray data) {
+    if (data.isEmpty()) {
+        return data;
+    }
+    QByteArray key = tilesKey(data);
+    QMutexLocker locker(&mutex);
+    bool found = tiles.contains(key);
+    if (!found) {
+        tiles.insert(key, data);
+    }
+    uses[key]++;
+    count(data.size(), !found);
+    return tiles.value(key);
+}
+
+QList<QRgb> AssetPool::internPalette(QList<QRgb> palette) {
+    QByteArray key = paletteKey(palette);
+    QMutexLocker locker(&mutex);
+    bool found = palettes.contains(key);
+    if (!found) {
+        palettes.insert(key, palette);
+    }
+    uses[key]++;
+    count(palette.length() * sizeof(QRgb), !found);
+    return palettes.value(key);
+}
+
+Metatile* AssetPool::internMetatile(Metatile *metatile) {
+    QByteArray key = metatileKey(metatile);
+    qint64 size = metatileSize(metatile);
+
+    QMutexLocker locker(&mutex);
+    Metatile *existing = metatiles.value(key, NULL);
+    uses[key]++;
+    count(size, !existing);
+    if (existing) {
+        delete metatile->tiles;
+        delete metatile;
+        return existing;
+    }
+    metatiles.insert(key, metatile);
+    return metatile;
+}
+
+// Takes the tileset's data out of the counts, as if it had never been interned. Data that no
+// other tileset uses is dropped, so a reloaded tileset doesn't leave its old data behind.
+void AssetPool::release(Tileset *tileset) {
+    QMutexLocker locker(&mutex);
+    if (!tileset->tiles.isEmpty()) {
+        QByteArray key = tilesKey(tileset->tiles);
+        if (uncount(key, tileset->tiles.size())) {
+            tiles.remove(key);
+        }
+    }
+    if (tileset->palettes) {
+        for (QList<QRgb> palette : *tileset->palettes) {
+            QByteArray key = paletteKey(palette);
+            if (uncount(key, palette.length() * sizeof(QRgb))) {
+                palettes.remove(key);
+            }
+        }
+    }
+    if (tileset->metatiles) {
+        for (Metatile *metatile : *tileset->metatiles) {
+            QByteArray key = metatileKey(metatile);
+            if (metatiles.value(key, NULL) == metatile && uncount(key, metatileSize(metatile))) {
+                metatiles.remove(key);
+                delete metatile->tiles;
+                delete metatile;
+            }
+        }
+    }
+}
+
+// Returns true if nothing uses the data anymore.
+bool AssetPool::uncount(QByteArray key, qint64 size) {
+    if (!uses.contains(key)) {
+        return false;
+    }
+    requests--;
+    requested -= size;
+    if (--uses[key] > 0) {
+        duplicates--;
+        return false;
+    }
+    uses.remove(key);
+    stored -= size;
+    return true;
+}
+
+QByteArray AssetPool::tilesKey(QByteArray tiles) {
+    return "t" + QCryptographicHash::hash(tiles, QCryptographicHash::Md5);
+}
+
+QByteArray AssetPool::paletteKey(QList<QRgb> palette) {
+    QByteArray key("p");
+    QDataStream out(&key, QIODevice::Append);
+    for (QRgb color : palette) {
+        out << quint32(color);
+    }
+    return key;
+}
+
+QByteArray AssetPool::metatileKey(Metatile *metatile) {
+    QByteArray key("m");
+    QDataStream out(&key, QIODevice::Append);
+    out << qint32(metatile->attr);
+    for (Tile tile : *metatile->tiles) {
+        out << qint16(tile.tile) << qint8(tile.xflip) << qint8(tile.yflip) << qint8(tile.palette);
+    }
+    return key;
+}
+
+qint64 AssetPool::metatileSize(Metatile *metatile) {
+    return sizeof(Metatile) + sizeof(QList<Tile>) + metatile->tiles->length() * sizeof(Tile);
+}
+
+void AssetPool::count(qint64 size, bool isNew) {
+    requests++;
+    requested += size;
+    if (isNew) {
+        stored += size;
+    } else {
+        duplicates++;
+    }
+}
+
+qint64 AssetPool::bytesRequested() {
+    QMutexLocker locker(&mutex);
+    return requested;
+}
+
+qint64 AssetPool::bytesStored() {
+    QMutexLocker locker(&mutex);
+    return stored;
+}
+
+QString AssetPool::summary() {
+    QMutexLocker locker(&mutex);
+    return QString("Tileset data: %1 KB kept for %2 KB loaded (%3 of %4 palettes, tile sheets and metatiles were duplicates, saving %5 KB)")
+            .arg(stored / 1024)
+            .arg(requested / 1024)
+            .arg(duplicates)
+            .arg(requests)
+            .arg((requested - stored) / 1024);
+}
@@ -0,0 +1,54 @@
+#ifndef ASSETPOOL_H
+#define ASSETPOOL_H
+
+#include "tileset.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QRgb>
+
+// Content-addressed store for tileset data. Many tilesets share identical palettes,
+// tile sheets and metatiles. Interning hands back the copy that's already loaded
+// instead, so each distinct piece of data is kept in memory once.
+//
+// Interned metatiles are shared between tilesets, so they must not be edited in place.
+// Safe to use from any thread.
+class AssetPool
+{
+public:
+    QByteArray internTiles(QByteArray tiles);
+    QList<QRgb> internPalette(QList<QRgb> palette);
+    // Takes ownership of metatile. It's deleted if an identical one was already interned.
+    Metatile* internMetatile(Metatile *metatile);
+    // Call before deleting a tileset whose data was interned, e.g. when it's reloaded.
+    void release(Tileset *tileset);
+
+    // Approximate sizes of everything interned, and of what's actually kept.
+    qint64 bytesRequested();
+    qint64 bytesStored();
+    QString summary();
+
+private:
+    void count(qint64 size, bool isNew);
+    bool uncount(QByteArray key, qint64 size);
+    static QByteArray tilesKey(QByteArray tiles);
+    static QByteArray paletteKey(QList<QRgb> palette);
+    static QByteArray metatileKey(Metatile *metatile);
+    static qint64 metatileSize(Metatile *metatile);
+
+    QMutex mutex;
+    QHash<QByteArray, QByteArray> tiles;
+    QHash<QByteArray, QList<QRgb>> palettes;
+    QHash<QByteArray, Metatile*> metatiles;
+    // How many loaded tilesets use each piece of data.
+    QHash<QByteArray, int> uses;
+    int requests = 0;
+    int duplicates = 0;
+    qint64 requested = 0;
+    qint64 stored = 0;
+};
+
+#endif // ASSETPOOL_H
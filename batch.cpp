@@ -0,0 +1,258 @@
+#include "batch.h"
+#include "tileset.h"
+#include "worldatlas.h"
+
+#include <QDir>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <cstdio>
+#include <functional>
+
+Batch::Batch(QString root) : out(stdout), err(stderr)
+{
+    project = new Project;
+    project->root = root;
+    SaveTransaction::recover(root);
+    project->map_format = MapFormat::projectFormat(root);
+}
+
+int Batch::run() {
+    QElapsedTimer total;
+    total.start();
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!loadProject()) {
+        err << QString("Failed to load project '%1'").arg(project->root) << endl;
+        return 2;
+    }
+    out << QString("Loaded %1 maps in %2 ms").arg(maps.length()).arg(timer.elapsed()) << endl;
+    out << project->assets->summary() << endl;
+
+    int failures = 0;
+    if (!render_dir.isEmpty()) {
+        timer.restart();
+        int failed = renderMaps();
+        out << QString("Rendered %1 maps in %2 ms (%3 failed)").arg(maps.length() - failed).arg(timer.elapsed()).arg(failed) << endl;
+        failures += failed;
+    }
+    if (validate) {
+        timer.restart();
+        int failed = validateMaps();
+        out << QString("Validated %1 maps in %2 ms (%3 with errors)").arg(maps.length()).arg(timer.elapsed()).arg(failed) << endl;
+        failures += failed;
+    }
+    if (resave) {
+        timer.restart();
+        bool saved = resaveMaps();
+        out << QString("Resaved %1 maps in %2 ms%3").arg(maps.length()).arg(timer.elapsed()).arg(saved ? "" : " (failed)") << endl;
+        if (!saved) {
+            failures++;
+        }
+    }
+
+    if (!atlas_dir.isEmpty()) {
+        timer.restart();
+        bool exported = exportAtlas();
+        out << QString("Exported world atlas in %1 ms%2").arg(timer.elapsed()).arg(exported ? "" : " (failed)") << endl;
+        if (!exported) {
+            failures++;
+        }
+    }
+
+    if (memory) {
+        out << project->memoryReport().join("\n") << endl;
+    }
+
+    project->saveCache();
+    out << QString("Finished in %1 ms using %2 threads").arg(total.elapsed()).arg(QThreadPool::globalInstance()->maxThreadCount()) << endl;
+    return failures ? 1 : 0;
+}
+
+// Maps are loaded one at a time, since the project's caches aren't thread-safe.
+// The layouts are parsed ahead of time in the background.
+bool Batch::loadProject() {
+    if (!QDir(project->root).exists()) {
+        return false;
+    }
+    project->loadCache();
+    project->readDataStructures();
+    project->readMapGroups();
+    if (project->mapNames->isEmpty()) {
+        return false;
+    }
+
+    project->prefetchMapLayouts(*project->mapNames);
+    for (QString map_name : *project->mapNames) {
+        Map *map = project->getMap(map_name);
+        if (map && map->layout) {
+            maps.append(map);
+        } else {
+            err << QString("error: %1: failed to load").arg(map_name) << endl;
+        }
+    }
+    return true;
+}
+
+QImage Batch::renderMapImage(Map *map) {
+    int width = map->getWidth();
+    int height = map->getHeight();
+    QImage image(width * 16, height * 16, QImage::Format_ARGB32);
+    image.fill(0);
+
+    Blockdata *blockdata = map->layout->blockdata;
+    if (!blockdata || !blockdata->blocks || !width) {
+        return image;
+    }
+    QPainter painter(&image);
+    for (int i = 0; i < blockdata->blocks->length(); i++) {
+        Block block = blockdata->blocks->value(i);
+        QImage metatile_image = Metatile::getMetatileImage(block.tile, map->layout->tileset_primary, map->layout->tileset_secondary);
+        painter.drawImage(QPoint((i % width) * 16, (i / width) * 16), metatile_image);
+    }
+    painter.end();
+    return image;
+}
+
+int Batch::renderMaps() {
+    if (!QDir().mkpath(render_dir)) {
+        err << QString("error: could not create '%1'").arg(render_dir) << endl;
+        return maps.length();
+    }
+
+    QString dir = render_dir;
+    std::function<bool(Map*)> render = [dir](Map *map) {
+        return renderMapImage(map).save(QString("%1/%2.png").arg(dir).arg(map->name));
+    };
+    QList<bool> results = QtConcurrent::blockingMapped<QList<bool>>(maps, render);
+
+    int failed = 0;
+    for (int i = 0; i < results.length(); i++) {
+        if (!results.value(i)) {
+            err << QString("error: %1: failed to write image").arg(maps.value(i)->name) << endl;
+            failed++;
+        }
+    }
+    return failed;
+}
+
+// Checks that everything the map refers to exists. Problems that the game tolerates
+// are reported as warnings; anything else is an error.
+// The project is only read here, so maps can be validated in parallel.
+QStringList Batch::validateMap(Map *map) {
+    QStringList problems;
+    int width = map->getWidth();
+    int height = map->getHeight();
+
+    for (Event *event : map->getAllEvents()) {
+        if (event->x() < 0 || event->x() >= width || event->y() < 0 || event->y() >= height) {
+            problems.append(QString("warning: %1: %2 event at (%3, %4) is outside the map")
+                            .arg(map->name).arg(event->get("event_type")).arg(event->x()).arg(event->y()));
+        }
+    }
+
+    for (Event *warp : map->events.value("warp_event_group")) {
+        QString destination = warp->get("destination_map_name");
+        // Warps to MAP_DYNAMIC have no destination of their own. The game picks one when they're used.
+        if (destination.isEmpty()) {
+            continue;
+        }
+        Map *destination_map = project->map_cache->value(destination);
+        if (!destination_map) {
+            problems.append(QString("error: %1: warp at (%2, %3) leads to unknown map '%4'")
+                            .arg(map->name).arg(warp->x()).arg(warp->y()).arg(destination));
+            continue;
+        }
+        bool ok;
+        int destination_warp = warp->get("destination_warp").toInt(&ok, 0);
+        // Warp id 0xFF is dynamic too, so there's no warp of the destination to check it against.
+        if (ok && destination_warp != 0xFF && (destination_warp < 0 || destination_warp >= destination_map->events.value("warp_event_group").length())) {
+            problems.append(QString("error: %1: warp at (%2, %3) leads to warp %4, but %5 has %6 warps")
+                            .arg(map->name).arg(warp->x()).arg(warp->y()).arg(destination_warp)
+                            .arg(destination).arg(destination_map->events.value("warp_event_group").length()));
+        }
+    }
+
+    QMap<QString, QString> opposites;
+    opposites.insert("up", "down");
+    opposites.insert("down", "up");
+    opposites.insert("left", "right");
+    opposites.insert("right", "left");
+    opposites.insert("dive", "emerge");
+    opposites.insert("emerge", "dive");
+    for (Connection *connection : map->connections) {
+        if (!opposites.contains(connection->direction)) {
+            problems.append(QString("error: %1: connection to %2 has invalid direction '%3'")
+                            .arg(map->name).arg(connection->map_name).arg(connection->direction));
+            continue;
+        }
+        Map *connected_map = project->map_cache->value(connection->map_name);
+        if (!connected_map) {
+            problems.append(QString("error: %1: connection to unknown map '%2'").arg(map->name).arg(connection->map_name));
+            continue;
+        }
+        bool reciprocated = false;
+        for (Connection *other : connected_map->connections) {
+            if (other->map_name == map->name && other->direction == opposites.value(connection->direction)) {
+                reciprocated = true;
+                if (other->offset.toInt(nullptr, 0) != -connection->offset.toInt(nullptr, 0)) {
+                    problems.append(QString("error: %1: %2 connection to %3 has offset %4, but the connection back has offset %5")
+                                    .arg(map->name).arg(connection->direction).arg(connection->map_name)
+                                    .arg(connection->offset).arg(other->offset));
+                }
+                break;
+            }
+        }
+        if (!reciprocated) {
+            problems.append(QString("error: %1: %2 connection to %3 has no %4 connection back")
+                            .arg(map->name).arg(connection->direction).arg(connection->map_name)
+                            .arg(opposites.value(connection->direction)));
+        }
+    }
+
+    return problems;
+}
+
+int Batch::validateMaps() {
+    std::function<QStringList(Map*)> validate = [this](Map *map) {
+        return validateMap(map);
+    };
+    QList<QStringList> results = QtConcurrent::blockingMapped<QList<QStringList>>(maps, validate);
+
+    int failed = 0;
+    for (QStringList problems : results) {
+        bool has_errors = false;
+        for (QString problem : problems) {
+            err << problem << endl;
+            if (problem.startsWith("error:")) {
+                has_errors = true;
+            }
+        }
+        if (has_errors) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+bool Batch::exportAtlas() {
+    WorldAtlas atlas(project);
+    atlas.build(atlas_start);
+    if (atlas.placements.isEmpty()) {
+        err << "error: no maps to put in the world atlas" << endl;
+        return false;
+    }
+    out << QString("World atlas: %1 maps, %2x%3 pixels").arg(atlas.placements.length()).arg(atlas.bounds.width()).arg(atlas.bounds.height()) << endl;
+    return atlas.exportTiles(atlas_dir);
+}
+
+// Regenerates every map's files. Only files whose contents changed are written.
+bool Batch::resaveMaps() {
+    project->beginSave();
+    project->saveAllMaps(true);
+    project->saveAllDataStructures();
+    return project->commitSave();
+}
@@ -0,0 +1,45 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "project.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QImage>
+#include <QTextStream>
+
+// Runs pretmap without a window, for CI. The project is loaded once, then every
+// map is rendered, validated and/or resaved. Per-map work runs on all cores.
+class Batch
+{
+public:
+    Batch(QString root);
+
+    QString render_dir; // Maps are rendered to <render_dir>/<map name>.png if set.
+    bool validate = false;
+    bool resave = false;
+    QString atlas_dir; // The world atlas is exported here if set.
+    QString atlas_start; // The map the atlas is laid out from. Defaults to the largest group of connected maps.
+    bool memory = false; // Print a breakdown of the memory used by the loaded project when done.
+
+    // Returns the process exit code: 0 on success, 1 if any map failed, 2 if the project couldn't be loaded.
+    int run();
+
+private:
+    bool loadProject();
+    int renderMaps();
+    int validateMaps();
+    bool resaveMaps();
+    bool exportAtlas();
+
+    static QImage renderMapImage(Map *map);
+    QStringList validateMap(Map *map);
+
+    Project *project = NULL;
+    QList<Map*> maps;
+    QTextStream out;
+    QTextStream err;
+};
+
+#endif // BATCH_H
@@ -0,0 +1,187 @@
+#include "syntheticproject.h"
+#include "project.h"
+#include "parseutil.h"
+#include "tileset.h"
+#include "map.h"
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+// Benchmarks for the paths that dominate loading and editing large projects.
+// Each run generates a synthetic project (see SyntheticProject) into a temporary
+// directory, scaled by the PRETMAP_BENCH_* environment variables.
+class Benchmarks : public QObject
+{
+    Q_OBJECT
+
+private:
+    SyntheticProject synthetic;
+    QTemporaryDir dir;
+    Project *project = NULL;
+    Map *map = NULL;
+
+    Project* openProject();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void parseEvents();
+    void readCDefines();
+    void loadProject();
+    void loadMap();
+    void getMetatileImage();
+    void renderMap();
+    void renderCollision();
+    void floodFillCollision();
+    void floodFillElevation();
+    void floodFillCollisionElevation();
+    void commit();
+    void pasteBlocks();
+    void moveBlocks();
+};
+
+Project* Benchmarks::openProject() {
+    // No project cache, so every load measures the parsers rather than the cache.
+    Project *project = new Project;
+    project->root = dir.path();
+    project->readDataStructures();
+    project->readMapGroups();
+    return project;
+}
+
+void Benchmarks::initTestCase() {
+    synthetic.readEnvironment();
+    qDebug() << QString("Synthetic project: %1").arg(synthetic.describe());
+    QVERIFY(dir.isValid());
+    QVERIFY(synthetic.generate(dir.path()));
+
+    project = openProject();
+    QCOMPARE(project->mapNames->length(), synthetic.groups * synthetic.maps_per_group);
+    map = project->getMap(synthetic.mapName(0, 0));
+    QVERIFY(map && map->layout && map->layout->blockdata);
+    QVERIFY(map->layout->tileset_primary && map->layout->tileset_secondary);
+}
+
+void Benchmarks::cleanupTestCase() {
+    // Maps and tilesets are owned by the project's caches, which are never freed; the process is exiting anyway.
+    delete project;
+    project = NULL;
+}
+
+void Benchmarks::parseEvents() {
+    QString text = synthetic.eventsText(synthetic.mapName(0, 0), synthetic.events_per_map * 10);
+    QBENCHMARK {
+        QList<QStringList> *commands = ParseUtil().parseAsm(text);
+        delete commands;
+    }
+}
+
+void Benchmarks::readCDefines() {
+    QString text = synthetic.definesText("FLAG_", synthetic.defines_per_header * 10);
+    QStringList prefixes;
+    prefixes << "FLAG_";
+    QBENCHMARK {
+        project->readCDefines(text, prefixes);
+    }
+}
+
+void Benchmarks::loadProject() {
+    // Loading fills caches, so only the first iteration is meaningful.
+    QBENCHMARK_ONCE {
+        Project *loaded = openProject();
+        for (QString map_name : *loaded->mapNames) {
+            loaded->getMap(map_name);
+        }
+    }
+}
+
+void Benchmarks::loadMap() {
+    QBENCHMARK_ONCE {
+        Project *loaded = openProject();
+        loaded->getMap(synthetic.mapName(0, 0));
+    }
+}
+
+void Benchmarks::getMetatileImage() {
+    Tileset *primary = map->layout->tileset_primary;
+    Tileset *secondary = map->layout->tileset_secondary;
+    QBENCHMARK {
+        for (int tile = 0; tile < 0x400; tile++) {
+            Metatile::getMetatileImage(tile, primary, secondary);
+        }
+    }
+}
+
+void Benchmarks::renderMap() {
+    QBENCHMARK {
+        map->render(true);
+    }
+}
+
+void Benchmarks::renderCollision() {
+    QBENCHMARK {
+        map->renderCollision(true);
+    }
+}
+
+// Fills toggle between two values so every iteration has a region to fill.
+void Benchmarks::floodFillCollision() {
+    uint collision = map->getBlock(0, 0)->collision;
+    QBENCHMARK {
+        collision ^= 1;
+        map->floodFillCollision(0, 0, collision);
+    }
+}
+
+void Benchmarks::floodFillElevation() {
+    uint elevation = map->getBlock(0, 0)->elevation;
+    QBENCHMARK {
+        elevation ^= 1;
+        map->floodFillElevation(0, 0, elevation);
+    }
+}
+
+void Benchmarks::floodFillCollisionElevation() {
+    uint collision = map->getBlock(0, 0)->collision;
+    uint elevation = map->getBlock(0, 0)->elevation;
+    QBENCHMARK {
+        collision ^= 1;
+        elevation ^= 1;
+        map->floodFillCollisionElevation(0, 0, collision, elevation);
+    }
+}
+
+void Benchmarks::commit() {
+    int width = map->getWidth();
+    int height = map->getHeight();
+    int i = 0;
+    QBENCHMARK {
+        Block *block = map->getBlock(i % width, (i / width) % height);
+        block->tile = (block->tile + 1) & 0x3ff;
+        map->commit();
+        i++;
+    }
+}
+
+void Benchmarks::pasteBlocks() {
+    BlockBuffer buffer = map->copyBlocks(QRect(0, 0, map->getWidth(), map->getHeight()));
+    int i = 0;
+    QBENCHMARK {
+        map->pasteBlocks(QPoint(i % 2, 0), &buffer);
+        i++;
+    }
+}
+
+void Benchmarks::moveBlocks() {
+    QRect rect(0, 0, map->getWidth() / 2, map->getHeight() / 2);
+    BlockBuffer fill(1, 1);
+    int i = 0;
+    QBENCHMARK {
+        map->moveBlocks(rect, QPoint(i % 2, i % 2), &fill, BlockBuffer::tileMask);
+        i++;
+    }
+}
+
+QTEST_MAIN(Benchmarks)
+#include "benchmarks.moc"
@@ -0,0 +1,65 @@
+#-------------------------------------------------
+#
+# Benchmarks for loading, rendering and editing.
+# Build and run separately from the editor:
+#   qmake benchmarks.pro && make && ./pretmap-benchmarks
+#
+#-------------------------------------------------
+
+QT       += core gui widgets concurrent testlib
+
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+TARGET = pretmap-benchmarks
+TEMPLATE = app
+
+INCLUDEPATH += ..
+
+
+SOURCES += benchmarks.cpp \
+    syntheticproject.cpp \
+    ../project.cpp \
+    ../map.cpp \
+    ../blockdata.cpp \
+    ../blockbuffer.cpp \
+    ../block.cpp \
+    ../tileset.cpp \
+    ../tile.cpp \
+    ../event.cpp \
+    ../parseutil.cpp \
+    ../projectcache.cpp \
+    ../lz77.cpp \
+    ../savetransaction.cpp \
+    ../textwriter.cpp \
+    ../journal.cpp \
+    ../projectwatcher.cpp \
+    ../mapformat.cpp \
+    ../mipmaps.cpp \
+    ../assetpool.cpp \
+    ../tracing.cpp \
+    ../perfcounters.cpp \
+    ../memoryusage.cpp
+
+HEADERS  += syntheticproject.h \
+    ../project.h \
+    ../map.h \
+    ../blockdata.h \
+    ../blockbuffer.h \
+    ../block.h \
+    ../tileset.h \
+    ../tile.h \
+    ../event.h \
+    ../parseutil.h \
+    ../projectcache.h \
+    ../lz77.h \
+    ../savetransaction.h \
+    ../textwriter.h \
+    ../journal.h \
+    ../projectwatcher.h \
+    ../mapformat.h \
+    ../mipmaps.h \
+    ../assetpool.h \
+    ../tracing.h \
+    ../perfcounters.h \
+    ../memoryusage.h
@@ -0,0 +1,329 @@
+#include "syntheticproject.h"
+#include "map.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+SyntheticProject::SyntheticProject()
+{
+}
+
+void SyntheticProject::readEnvironment() {
+    QList<QPair<const char*, int*>> settings;
+    settings << qMakePair("PRETMAP_BENCH_GROUPS", &groups);
+    settings << qMakePair("PRETMAP_BENCH_MAPS_PER_GROUP", &maps_per_group);
+    settings << qMakePair("PRETMAP_BENCH_MAP_WIDTH", &map_width);
+    settings << qMakePair("PRETMAP_BENCH_MAP_HEIGHT", &map_height);
+    settings << qMakePair("PRETMAP_BENCH_EVENTS", &events_per_map);
+    settings << qMakePair("PRETMAP_BENCH_TILESETS", &tileset_pairs);
+    settings << qMakePair("PRETMAP_BENCH_DEFINES", &defines_per_header);
+    for (QPair<const char*, int*> setting : settings) {
+        bool ok;
+        int value = QString(qgetenv(setting.first)).toInt(&ok);
+        if (ok && value > 0) {
+            *setting.second = value;
+        }
+    }
+}
+
+QString SyntheticProject::describe() {
+    return QString("%1 groups x %2 maps, %3x%4 metatiles, %5 events per map, %6 tileset pairs")
+            .arg(groups).arg(maps_per_group).arg(map_width).arg(map_height).arg(events_per_map).arg(tileset_pairs);
+}
+
+QString SyntheticProject::mapName(int group, int index) {
+    return QString("Synthetic%1Route%2").arg(group).arg(index);
+}
+
+quint32 SyntheticProject::random() {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7fff;
+}
+
+bool SyntheticProject::write(QString path, QByteArray data) {
+    QString full_path = root + "/" + path;
+    QDir().mkpath(QFileInfo(full_path).absolutePath());
+    QFile file(full_path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        qDebug() << QString("Could not write '%1'").arg(full_path);
+        return false;
+    }
+    return true;
+}
+
+bool SyntheticProject::generate(QString root) {
+    this->root = root;
+    seed = 1;
+
+    QString groups_text;
+    QStringList group_labels;
+    QString layouts_table = "\t.align 2\ngMapLayouts::\n";
+    QString connections_includes;
+    for (int group = 0; group < groups; group++) {
+        QString label = QString("gMapGroup%1").arg(group);
+        group_labels << label;
+        groups_text += label + "::\n";
+        for (int index = 0; index < maps_per_group; index++) {
+            QString name = mapName(group, index);
+            groups_text += QString("\t.4byte %1\n").arg(name);
+            layouts_table += QString("\t.4byte %1_Layout\n").arg(name);
+            if (maps_per_group > 1) {
+                connections_includes += QString("\t.include \"data/maps/%1/connections.inc\"\n").arg(name);
+            }
+            if (!writeMap(group, index)) {
+                return false;
+            }
+        }
+        groups_text += "\n";
+    }
+    groups_text += "\t.align 2\ngMapGroups::\n";
+    for (QString label : group_labels) {
+        groups_text += QString("\t.4byte %1\n").arg(label);
+    }
+
+    QString headers_text;
+    QString graphics_text;
+    QString metatiles_text;
+    for (int i = 0; i < tileset_pairs * 2; i++) {
+        bool secondary = i % 2;
+        QString name = QString("Synthetic%1").arg(i);
+        QString dir = QString("data/tilesets/%1/%2").arg(secondary ? "secondary" : "primary").arg(name.toLower());
+        headers_text += QString("gTileset_%1::\n").arg(name);
+        headers_text += "\t.byte FALSE\n";
+        headers_text += QString("\t.byte %1\n").arg(secondary ? "TRUE" : "FALSE");
+        headers_text += "\t.2byte 0\n";
+        headers_text += QString("\t.4byte gTilesetTiles_%1\n").arg(name);
+        headers_text += QString("\t.4byte gTilesetPalettes_%1\n").arg(name);
+        headers_text += QString("\t.4byte gMetatiles_%1\n").arg(name);
+        headers_text += QString("\t.4byte gMetatileAttributes_%1\n").arg(name);
+        headers_text += "\t.4byte NULL\n\n";
+
+        graphics_text += QString("gTilesetTiles_%1::\n\t.incbin \"%2/tiles.4bpp\"\n\n").arg(name).arg(dir);
+        graphics_text += QString("gTilesetPalettes_%1::\n").arg(name);
+        for (int j = 0; j < 16; j++) {
+            graphics_text += QString("\t.incbin \"%1/palettes/%2.gbapal\"\n").arg(dir).arg(j, 2, 10, QChar('0'));
+        }
+        graphics_text += "\n";
+
+        metatiles_text += QString("gMetatiles_%1::\n\t.incbin \"%2/metatiles.bin\"\n\n").arg(name).arg(dir);
+        metatiles_text += QString("gMetatileAttributes_%1::\n\t.incbin \"%2/metatile_attributes.bin\"\n\n").arg(name).arg(dir);
+
+        if (!writeTileset(i, secondary)) {
+            return false;
+        }
+    }
+
+    bool ok = true;
+    ok &= write("data/maps/groups.inc", groups_text.toUtf8());
+    ok &= write("data/layouts_table.inc", layouts_table.toUtf8());
+    ok &= write("data/maps/connections.inc", connections_includes.toUtf8());
+    ok &= write("data/tilesets/headers.inc", headers_text.toUtf8());
+    ok &= write("data/tilesets/graphics.inc", graphics_text.toUtf8());
+    ok &= write("data/tilesets/metatiles.inc", metatiles_text.toUtf8());
+
+    QList<QPair<QString, QString>> headers;
+    headers << qMakePair(QString("region_map_sections.h"), QString("MAPSEC_"));
+    headers << qMakePair(QString("items.h"), QString("ITEM_"));
+    headers << qMakePair(QString("flags.h"), QString("FLAG_"));
+    headers << qMakePair(QString("vars.h"), QString("VAR_"));
+    headers << qMakePair(QString("event_object_movement_constants.h"), QString("MOVEMENT_TYPE_"));
+    headers << qMakePair(QString("weather.h"), QString("WEATHER_"));
+    headers << qMakePair(QString("secret_bases.h"), QString("SECRET_BASE_"));
+    headers << qMakePair(QString("bg_event_constants.h"), QString("BG_EVENT_PLAYER_FACING_"));
+    for (QPair<QString, QString> header : headers) {
+        ok &= write("include/constants/" + header.first, definesText(header.second, defines_per_header).toUtf8());
+    }
+    ok &= write("include/constants/map_types.h", (definesText("MAP_TYPE_", 8) + definesText("MAP_BATTLE_SCENE_", 8)).toUtf8());
+    return ok;
+}
+
+bool SyntheticProject::writeMap(int group, int index) {
+    QString name = mapName(group, index);
+    int layout_id = group * maps_per_group + index + 1;
+    bool has_connections = maps_per_group > 1;
+    int pair = (layout_id - 1) % tileset_pairs;
+
+    QString header;
+    header += name + "::\n";
+    header += QString("\t.4byte %1_Layout\n").arg(name);
+    header += QString("\t.4byte %1_MapEvents\n").arg(name);
+    header += QString("\t.4byte %1_MapScripts\n").arg(name);
+    header += has_connections ? QString("\t.4byte %1_MapConnections\n").arg(name) : QString("\t.4byte 0x0\n");
+    header += "\t.2byte MUS_DAN02\n";
+    header += QString("\t.2byte %1\n").arg(layout_id);
+    header += "\t.byte MAPSEC_0\n";
+    header += "\t.byte FALSE\n";
+    header += "\t.byte WEATHER_0\n";
+    header += "\t.byte MAP_TYPE_0\n";
+    header += "\t.2byte 0\n";
+    header += "\t.byte TRUE\n";
+    header += "\t.byte MAP_BATTLE_SCENE_0\n";
+
+    // Each group is a row of maps joined edge to edge.
+    QString connections;
+    if (has_connections) {
+        int count = 0;
+        connections += QString("%1_MapConnectionsList::\n").arg(name);
+        if (index > 0) {
+            connections += QString("\tconnection left, 0, %1\n").arg(Map::mapConstantFromName(mapName(group, index - 1)));
+            count++;
+        }
+        if (index + 1 < maps_per_group) {
+            connections += QString("\tconnection right, 0, %1\n").arg(Map::mapConstantFromName(mapName(group, index + 1)));
+            count++;
+        }
+        connections += "\n";
+        connections += QString("%1_MapConnections::\n").arg(name);
+        connections += QString("\t.4byte %1\n").arg(count);
+        connections += QString("\t.4byte %1_MapConnectionsList\n").arg(name);
+    }
+
+    QString layout;
+    layout += QString("%1_MapBorder::\n\t.incbin \"data/layouts/%1/border.bin\"\n\n").arg(name);
+    layout += QString("%1_MapBlockdata::\n\t.incbin \"data/layouts/%1/map.bin\"\n\n").arg(name);
+    layout += "\t.align 2\n";
+    layout += QString("%1_Layout::\n").arg(name);
+    layout += QString("\t.4byte %1\n").arg(map_width);
+    layout += QString("\t.4byte %1\n").arg(map_height);
+    layout += QString("\t.4byte %1_MapBorder\n").arg(name);
+    layout += QString("\t.4byte %1_MapBlockdata\n").arg(name);
+    layout += QString("\t.4byte gTileset_Synthetic%1\n").arg(pair * 2);
+    layout += QString("\t.4byte gTileset_Synthetic%1\n").arg(pair * 2 + 1);
+
+    // Terrain comes in patches, like real maps, so flood fills have regions to fill.
+    QByteArray blockdata;
+    for (int y = 0; y < map_height; y++)
+    for (int x = 0; x < map_width; x++) {
+        int patch = ((x / 8) * 7 + (y / 8) * 13 + layout_id) % 16;
+        uint16_t tile = (random() % 4 == 0) ? (random() % 0x400) : (patch * 32 + (x % 4) + (y % 4) * 8);
+        uint16_t collision = patch % 3 == 0 ? 1 : 0;
+        uint16_t elevation = 3;
+        uint16_t word = (tile & 0x3ff) | (collision << 10) | (elevation << 12);
+        blockdata.append(char(word & 0xff));
+        blockdata.append(char(word >> 8));
+    }
+    QByteArray border;
+    for (int i = 0; i < 4; i++) {
+        border.append(char(0x01));
+        border.append(char(0x30));
+    }
+
+    bool ok = true;
+    ok &= write(QString("data/maps/%1/header.inc").arg(name), header.toUtf8());
+    ok &= write(QString("data/maps/%1/events.inc").arg(name), eventsText(name, events_per_map).toUtf8());
+    if (has_connections) {
+        ok &= write(QString("data/maps/%1/connections.inc").arg(name), connections.toUtf8());
+    }
+    ok &= write(QString("data/layouts/%1/layout.inc").arg(name), layout.toUtf8());
+    ok &= write(QString("data/layouts/%1/map.bin").arg(name), blockdata);
+    ok &= write(QString("data/layouts/%1/border.bin").arg(name), border);
+    return ok;
+}
+
+QString SyntheticProject::eventsText(QString map_name, int num_events) {
+    // Split the events between the four groups like a typical route.
+    int num_objects = num_events / 2;
+    int num_warps = num_events / 6;
+    int num_coords = num_events / 6;
+    int num_bgs = num_events - num_objects - num_warps - num_coords;
+
+    QString text;
+    text += Map::objectEventsLabelFromName(map_name) + "::\n";
+    for (int i = 0; i < num_objects; i++) {
+        text += QString("\tobject_event %1, EVENT_OBJ_GFX_%2, 0, %3, %4, 3, MOVEMENT_TYPE_%5, 1, 1, 0, 0, %6_EventScript_%1, FLAG_%7\n")
+                .arg(i + 1).arg(i % 8).arg(i % map_width).arg((i * 3) % map_height).arg(i % 4).arg(map_name).arg(i % defines_per_header);
+    }
+    text += "\n" + Map::warpEventsLabelFromName(map_name) + "::\n";
+    for (int i = 0; i < num_warps; i++) {
+        text += QString("\twarp_def %1, %2, 0, %3, %4\n")
+                .arg(i % map_width).arg(map_height - 1).arg(i).arg(Map::mapConstantFromName(map_name));
+    }
+    text += "\n" + Map::coordEventsLabelFromName(map_name) + "::\n";
+    for (int i = 0; i < num_coords; i++) {
+        if (i % 2) {
+            text += QString("\tcoord_weather_event %1, %2, 3, COORD_EVENT_WEATHER_%3\n").arg(i % map_width).arg(1).arg(i % 4);
+        } else {
+            text += QString("\tcoord_event %1, %2, 3, VAR_%3, 0, %4_EventScript_Trigger%5\n").arg(i % map_width).arg(2).arg(i).arg(map_name).arg(i);
+        }
+    }
+    text += "\n" + Map::bgEventsLabelFromName(map_name) + "::\n";
+    for (int i = 0; i < num_bgs; i++) {
+        if (i % 2) {
+            text += QString("\tbg_hidden_item_event %1, %2, 3, ITEM_%3, FLAG_%4\n").arg(i % map_width).arg(3).arg(i).arg(i);
+        } else {
+            text += QString("\tbg_event %1, %2, 3, BG_EVENT_PLAYER_FACING_%3, %4_EventScript_Sign%5\n").arg(i % map_width).arg(4).arg(i % 4).arg(map_name).arg(i);
+        }
+    }
+    text += "\n" + map_name + "_MapEvents::\n";
+    text += QString("\tmap_events %1, %2, %3, %4\n")
+            .arg(Map::objectEventsLabelFromName(map_name))
+            .arg(Map::warpEventsLabelFromName(map_name))
+            .arg(Map::coordEventsLabelFromName(map_name))
+            .arg(Map::bgEventsLabelFromName(map_name));
+    return text;
+}
+
+QString SyntheticProject::definesText(QString prefix, int num_defines) {
+    QString text = QString("#ifndef GUARD_%1H\n#define GUARD_%1H\n\n").arg(prefix);
+    for (int i = 0; i < num_defines; i++) {
+        if (i > 0 && i % 16 == 0) {
+            // Some defines are expressions of earlier ones, like in the real headers.
+            text += QString("#define %1%2 (%1%3 + 1)\n").arg(prefix).arg(i).arg(i - 1);
+        } else {
+            text += QString("#define %1%2 0x%3\n").arg(prefix).arg(i).arg(i, 0, 16);
+        }
+    }
+    text += "\n#endif\n";
+    return text;
+}
+
+bool SyntheticProject::writeTileset(int index, bool secondary) {
+    QString dir = QString("data/tilesets/%1/synthetic%2").arg(secondary ? "secondary" : "primary").arg(index);
+    int num_tiles = secondary ? 0x180 : 0x200;
+    int num_metatiles = secondary ? 0x180 : 0x200;
+
+    // Gradients and stripes, so tiles aren't all alike.
+    QByteArray tiles;
+    for (int t = 0; t < num_tiles; t++)
+    for (int p = 0; p < 32; p++) {
+        int low = (t + p) % 16;
+        int high = (t * 3 + p / 4) % 16;
+        tiles.append(char(low | (high << 4)));
+    }
+
+    QByteArray metatiles;
+    QByteArray attributes;
+    int tile_base = secondary ? 0x200 : 0;
+    for (int m = 0; m < num_metatiles; m++) {
+        for (int j = 0; j < 8; j++) {
+            int tile = tile_base + (m * 8 + j) % num_tiles;
+            int palette = (m / 16 + index) % (secondary ? 13 : 6);
+            uint16_t word = (tile & 0x3ff) | ((j & 1) << 10) | (palette << 12);
+            metatiles.append(char(word & 0xff));
+            metatiles.append(char(word >> 8));
+        }
+        uint16_t attribute = (m % 5 == 0) ? 0x1001 : 0;
+        attributes.append(char(attribute & 0xff));
+        attributes.append(char(attribute >> 8));
+    }
+
+    bool ok = true;
+    ok &= write(dir + "/tiles.4bpp", tiles);
+    ok &= write(dir + "/metatiles.bin", metatiles);
+    ok &= write(dir + "/metatile_attributes.bin", attributes);
+    for (int i = 0; i < 16; i++) {
+        // Some palettes are shared between tilesets, like in the real games.
+        int variant = i < 4 ? 0 : index;
+        QByteArray palette;
+        for (int c = 0; c < 16; c++) {
+            uint16_t color = ((c * 2 + variant) & 0x1f) | (((c + i) & 0x1f) << 5) | (((31 - c + variant) & 0x1f) << 10);
+            palette.append(char(color & 0xff));
+            palette.append(char(color >> 8));
+        }
+        ok &= write(QString("%1/palettes/%2.gbapal").arg(dir).arg(i, 2, 10, QChar('0')), palette);
+    }
+    return ok;
+}
@@ -0,0 +1,46 @@
+#ifndef SYNTHETICPROJECT_H
+#define SYNTHETICPROJECT_H
+
+#include <QString>
+#include <QByteArray>
+
+// Writes a made-up project shaped like pokeemerald: map groups, headers, events,
+// connections, layouts with blockdata, tilesets and constants headers. The maps in
+// each group are connected in a row. Everything is generated from a fixed seed,
+// so the same settings always give the same project.
+class SyntheticProject
+{
+public:
+    SyntheticProject();
+
+    int groups = 4;
+    int maps_per_group = 25;
+    int map_width = 40;
+    int map_height = 40;
+    int events_per_map = 20;
+    int tileset_pairs = 4;
+    int defines_per_header = 200;
+
+    // Reads PRETMAP_BENCH_<SETTING> environment variables (e.g. PRETMAP_BENCH_GROUPS).
+    void readEnvironment();
+
+    bool generate(QString root);
+
+    QString mapName(int group, int index);
+    QString describe();
+
+    // Text in the same shape as the generated files, for benchmarking the parsers directly.
+    QString eventsText(QString map_name, int num_events);
+    QString definesText(QString prefix, int num_defines);
+
+private:
+    bool write(QString path, QByteArray data);
+    bool writeMap(int group, int index);
+    bool writeTileset(int index, bool secondary);
+    quint32 random();
+
+    QString root;
+    quint32 seed = 1;
+};
+
+#endif // SYNTHETICPROJECT_H
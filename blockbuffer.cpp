@@ -0,0 +1,69 @@
+#include "blockbuffer.h"
+
+#include <QDataStream>
+
+const QString BlockBuffer::mimeType = "application/x-pretmap-blocks";
+const quint32 BlockBuffer::magic = 0x504d424b; // "PMBK"
+
+// Bump this whenever the serialized layout changes.
+const quint32 BlockBuffer::version = 1;
+
+BlockBuffer::BlockBuffer(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    blocks.fill(0, width * height);
+}
+
+bool BlockBuffer::isEmpty() {
+    return width <= 0 || height <= 0;
+}
+
+Block BlockBuffer::at(int x, int y) {
+    return Block(blocks.value(y * width + x));
+}
+
+void BlockBuffer::set(int x, int y, Block block) {
+    blocks[y * width + x] = block.rawValue();
+}
+
+QList<int> BlockBuffer::tiles() {
+    QList<int> tiles;
+    for (quint16 block : blocks) {
+        tiles.append(Block(block).tile);
+    }
+    return tiles;
+}
+
+QByteArray BlockBuffer::serialize() {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << magic << version;
+    out << tileset_primary_label << tileset_secondary_label;
+    out << qint32(width) << qint32(height) << blocks;
+    return data;
+}
+
+// Returns false if data isn't a block buffer written by this version.
+bool BlockBuffer::deserialize(QByteArray data, BlockBuffer *buffer) {
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 dataMagic, dataVersion;
+    in >> dataMagic >> dataVersion;
+    if (in.status() != QDataStream::Ok || dataMagic != magic || dataVersion != version) {
+        return false;
+    }
+
+    BlockBuffer result;
+    qint32 width, height;
+    in >> result.tileset_primary_label >> result.tileset_secondary_label;
+    in >> width >> height >> result.blocks;
+    if (in.status() != QDataStream::Ok || width <= 0 || height <= 0 || result.blocks.size() != qint64(width) * height) {
+        return false;
+    }
+    result.width = width;
+    result.height = height;
+    *buffer = result;
+    return true;
+}
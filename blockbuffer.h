@@ -0,0 +1,45 @@
+#ifndef BLOCKBUFFER_H
+#define BLOCKBUFFER_H
+
+#include "block.h"
+
+#include <QVector>
+#include <QList>
+#include <QString>
+#include <QByteArray>
+
+// A rectangle of blocks, including their collision and elevation, stored row by row
+// as raw block values. Used to copy, cut, paste and move parts of maps, and to put
+// them on the clipboard.
+class BlockBuffer
+{
+public:
+    BlockBuffer() {}
+    BlockBuffer(int width, int height);
+    static const QString mimeType;
+    static const quint32 magic;
+    static const quint32 version;
+
+    // Which parts of a block an operation writes, as bits of Block::rawValue().
+    static const quint16 tileMask = 0x03ff;
+    static const quint16 collisionMask = 0x0c00;
+    static const quint16 elevationMask = 0xf000;
+    static const quint16 allMask = 0xffff;
+
+    int width = 0;
+    int height = 0;
+    QVector<quint16> blocks;
+    // The tilesets the metatiles came from, so pasting into a map with other tilesets can be noticed.
+    QString tileset_primary_label;
+    QString tileset_secondary_label;
+
+    bool isEmpty();
+    Block at(int x, int y);
+    void set(int x, int y, Block block);
+    QList<int> tiles();
+
+    QByteArray serialize();
+    static bool deserialize(QByteArray data, BlockBuffer *buffer);
+};
+
+#endif // BLOCKBUFFER_H
@@ -1,8 +1,18 @@
 #include "editor.h"
 #include "event.h"
+#include "tracing.h"
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QScreen>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QCheckBox>
 #include <QPainter>
 #include <QMouseEvent>
+#include <QStyleOptionGraphicsItem>
+#include <QApplication>
+#include <QClipboard>
+#include <QMimeData>
 #include <math.h>
 
 bool selectingEvent = false;
@@ -11,20 +21,31 @@ Editor::Editor(Ui::MainWindow* ui)
 {
     this->ui = ui;
     selected_events = new QList<DraggablePixmapItem*>;
+    connect(ui->checkBox_ToggleGrid, &QCheckBox::toggled, [this](bool checked) {
+        for (QGraphicsLineItem *line : gridLines) {
+            line->setVisible(checked);
+        }
+    });
 }
 
-void Editor::saveProject() {
+bool Editor::saveProject(std::function<void(int, int)> progress) {
     if (project) {
+        project->beginSave();
         project->saveAllMaps();
         project->saveAllDataStructures();
+        return project->commitSave(progress);
     }
+    return true;
 }
 
-void Editor::save() {
+bool Editor::save(std::function<void(int, int)> progress) {
     if (project && map) {
+        project->beginSave();
         project->saveMap(map);
         project->saveAllDataStructures();
+        return project->commitSave(progress);
     }
+    return true;
 }
 
 void Editor::undo() {
@@ -46,7 +67,7 @@ void Editor::redo() {
 void Editor::setEditingMap() {
     current_view = map_item;
     if (map_item) {
-        displayMapConnections();
+        updateMapConnections();
         map_item->draw();
         map_item->setVisible(true);
         map_item->setEnabled(true);
@@ -65,7 +86,7 @@ void Editor::setEditingMap() {
 void Editor::setEditingCollision() {
     current_view = collision_item;
     if (collision_item) {
-        displayMapConnections();
+        updateMapConnections();
         collision_item->draw();
         collision_item->setVisible(true);
         setConnectionsVisibility(true);
@@ -176,6 +197,7 @@ void Editor::setCurrentConnectionDirection(QString curDirection) {
         return;
 
     selected_connection_item->connection->direction = curDirection;
+    map->has_unsaved_changes = true;
 
     Map *connected_map = project->getMap(selected_connection_item->connection->map_name);
     QPixmap pixmap = connected_map->renderConnection(*selected_connection_item->connection);
@@ -223,6 +245,7 @@ void Editor::updateCurrentConnectionDirection(QString curDirection) {
 }
 
 void Editor::onConnectionMoved(Connection* connection) {
+    map->has_unsaved_changes = true;
     updateMirroredConnectionOffset(connection);
     onConnectionOffsetChanged(connection->offset.toInt());
 }
@@ -310,6 +333,7 @@ void Editor::onConnectionDirectionChanged(QString newDirection) {
 }
 
 void Editor::onBorderMetatilesChanged() {
+    map->layout->has_unsaved_changes = true;
     displayMapBorder();
 }
 
@@ -321,6 +345,7 @@ void Editor::setConnectionsVisibility(bool visible) {
 }
 
 void Editor::setMap(QString map_name) {
+    TRACE_ZONE("Editor::setMap", "scene");
     if (map_name.isNull()) {
         return;
     }
@@ -371,55 +396,76 @@ void Editor::mouseEvent_collision(QGraphicsSceneMouseEvent *event, CollisionPixm
 void Editor::updateCurrentMetatilesSelection() {
     if (lastSelectedMetatilesFromMap) {
         // Remember the copied metatiles from the previously-opened map
-        map->selected_metatiles_width = this->copiedMetatileSelectionWidth;
-        map->selected_metatiles_height = this->copiedMetatileSelectionHeight;
-        *map->selected_metatiles = *this->copiedMetatileSelection;
+        map->setSelectedBlocks(copiedMetatileSelection);
     }
 }
 
 void Editor::displayMap() {
+    TRACE_ZONE("Editor::displayMap", "scene");
+    QElapsedTimer timer;
+    timer.start();
     if (!scene)
         scene = new QGraphicsScene;
 
-    if (map_item && scene) {
-        scene->removeItem(map_item);
-        delete map_item;
-    }
-    map_item = new MapPixmapItem(map, this);
-    connect(map_item, SIGNAL(mouseEvent(QGraphicsSceneMouseEvent*,MapPixmapItem*)),
-            this, SLOT(mouseEvent_map(QGraphicsSceneMouseEvent*,MapPixmapItem*)));
-
-    map_item->draw(true);
-    scene->addItem(map_item);
-
-    if (collision_item && scene) {
-        scene->removeItem(collision_item);
-        delete collision_item;
-    }
-    collision_item = new CollisionPixmapItem(map, this);
-    connect(collision_item, SIGNAL(mouseEvent(QGraphicsSceneMouseEvent*,CollisionPixmapItem*)),
-            this, SLOT(mouseEvent_collision(QGraphicsSceneMouseEvent*,CollisionPixmapItem*)));
-
-    collision_item->draw(true);
-    scene->addItem(collision_item);
-
-    int tw = 16;
-    int th = 16;
-    scene->setSceneRect(
-        -6 * tw,
-        -6 * th,
-        map_item->pixmap().width() + 12 * tw,
-        map_item->pixmap().height() + 12 * th
-    );
-
-    displayMetatiles();
-    displayBorderMetatiles();
-    displayCurrentMetatilesSelection();
-    displayCollisionMetatiles();
-    displayMapEvents();
-    displayMapConnections();
-    displayMapBorder();
-    displayMapGrid();
+    // Work out what changed since the scene was last built. Opening a different map changes everything.
+    bool mapChanged = map != scene_map;
+    QSize size(map->getWidth(), map->getHeight());
+    bool sizeChanged = mapChanged || size != scene_size;
+    QPair<Tileset*, Tileset*> tilesets(map->layout->tileset_primary, map->layout->tileset_secondary);
+    bool tilesetsChanged = mapChanged || tilesets != scene_tilesets;
+    scene_map = map;
+    scene_size = size;
+    scene_tilesets = tilesets;
+
+    if (!map_item) {
+        map_item = new MapPixmapItem(map, this);
+        connect(map_item, SIGNAL(mouseEvent(QGraphicsSceneMouseEvent*,MapPixmapItem*)),
+                this, SLOT(mouseEvent_map(QGraphicsSceneMouseEvent*,MapPixmapItem*)));
+        scene->addItem(map_item);
+    }
+    if (!collision_item) {
+        collision_item = new CollisionPixmapItem(map, this);
+        connect(collision_item, SIGNAL(mouseEvent(QGraphicsSceneMouseEvent*,CollisionPixmapItem*)),
+                this, SLOT(mouseEvent_collision(QGraphicsSceneMouseEvent*,CollisionPixmapItem*)));
+        scene->addItem(collision_item);
+    }
+    // Maps that were already rendered (e.g. by the prefetcher) only redraw what changed since.
+    if (sizeChanged || tilesetsChanged) {
+        map_item->setMap(map);
+        map_item->draw();
+        collision_item->setMap(map);
+        collision_item->draw();
+    }
+
+    if (sizeChanged) {
+        int tw = 16;
+        int th = 16;
+        scene->setSceneRect(
+            -6 * tw,
+            -6 * th,
+            map_item->pixmap().width() + 12 * tw,
+            map_item->pixmap().height() + 12 * th
+        );
+    }
+
+    if (tilesetsChanged) {
+        displayMetatiles();
+        displayBorderMetatiles();
+        displayCurrentMetatilesSelection();
+        displayCollisionMetatiles();
+    }
+    if (mapChanged || map->getAllEvents() != scene_events) {
+        displayMapEvents();
+    }
+    if (sizeChanged || getConnectionsKey() != scene_connections) {
+        displayMapConnections();
+    }
+    if (sizeChanged || tilesetsChanged) {
+        displayMapBorder();
+    }
+    if (sizeChanged) {
+        displayMapGrid();
+    }
 
     if (map_item) {
         map_item->setVisible(false);
@@ -430,27 +476,174 @@ void Editor::displayMap() {
     if (events_group) {
         events_group->setVisible(false);
     }
+    last_display_map_ms = timer.elapsed();
+}
+
+// Makes the next displayMap() rebuild the whole scene, e.g. after the map was reread from disk.
+void Editor::invalidateMapScene() {
+    scene_map = NULL;
+}
+
+// The map or collision view, while one of them is being edited.
+MapPixmapItem *Editor::getBlockEditingItem() {
+    if (!map) {
+        return NULL;
+    }
+    if (current_view == map_item && map_item && map_item->isEnabled()) {
+        return map_item;
+    }
+    if (current_view == collision_item && collision_item) {
+        return collision_item;
+    }
+    return NULL;
+}
+
+// What fills a selection, and what cutting or moving it leaves behind. That's the selected
+// metatiles on the map view, and the selected collision and elevation on the collision view.
+BlockBuffer Editor::getFillPattern(quint16 *mask) {
+    if (current_view == collision_item) {
+        BlockBuffer pattern(1, 1);
+        Block block(0);
+        *mask = 0;
+        if (map->paint_collision >= 0) {
+            block.collision = map->paint_collision;
+            *mask |= BlockBuffer::collisionMask;
+        }
+        if (map->paint_elevation >= 0) {
+            block.elevation = map->paint_elevation;
+            *mask |= BlockBuffer::elevationMask;
+        }
+        pattern.set(0, 0, block);
+        return pattern;
+    }
+
+    if (!map->selected_blocks.isEmpty()) {
+        *mask = BlockBuffer::allMask;
+        return map->selected_blocks;
+    }
+    BlockBuffer pattern(map->selected_metatiles_width, map->selected_metatiles_height);
+    for (int i = 0; i < pattern.blocks.size() && i < map->selected_metatiles->length(); i++) {
+        Block block(0);
+        block.tile = map->selected_metatiles->at(i);
+        pattern.blocks[i] = block.rawValue();
+    }
+    *mask = BlockBuffer::tileMask;
+    return pattern;
+}
+
+void Editor::copySelection() {
+    MapPixmapItem *item = getBlockEditingItem();
+    if (!item || item->selection.isEmpty()) {
+        return;
+    }
+    BlockBuffer buffer = map->copyBlocks(item->selection);
+    if (buffer.isEmpty()) {
+        return;
+    }
+    QMimeData *data = new QMimeData;
+    data->setData(BlockBuffer::mimeType, buffer.serialize());
+    QApplication::clipboard()->setMimeData(data);
+}
+
+void Editor::cutSelection() {
+    MapPixmapItem *item = getBlockEditingItem();
+    if (!item || item->selection.isEmpty()) {
+        return;
+    }
+    copySelection();
+    fillSelection();
+}
+
+// Pastes over the selection, or under the cursor if nothing is selected. The pasted blocks are selected afterwards.
+void Editor::pasteBlocks() {
+    MapPixmapItem *item = getBlockEditingItem();
+    if (!item) {
+        return;
+    }
+    const QMimeData *data = QApplication::clipboard()->mimeData();
+    if (!data || !data->hasFormat(BlockBuffer::mimeType)) {
+        return;
+    }
+    BlockBuffer buffer;
+    if (!BlockBuffer::deserialize(data->data(BlockBuffer::mimeType), &buffer)) {
+        qDebug() << "Can't paste blocks copied by an incompatible version of pretmap";
+        return;
+    }
+    if (buffer.tileset_primary_label != map->layout->tileset_primary_label
+            || buffer.tileset_secondary_label != map->layout->tileset_secondary_label) {
+        qDebug() << QString("Pasting blocks copied with tilesets %1 and %2 into a map using %3 and %4")
+                    .arg(buffer.tileset_primary_label)
+                    .arg(buffer.tileset_secondary_label)
+                    .arg(map->layout->tileset_primary_label)
+                    .arg(map->layout->tileset_secondary_label);
+    }
+
+    QPoint pos = item->selection.isEmpty() ? item->getHoveredCell() : item->selection.topLeft();
+    if (pos.x() < 0 || pos.y() < 0) {
+        pos = QPoint(0, 0);
+    }
+    map->pasteBlocks(pos, &buffer);
+    item->selection = QRect(pos, QSize(buffer.width, buffer.height)) & QRect(0, 0, map->getWidth(), map->getHeight());
+    item->update();
+    redrawBlocks();
+}
+
+void Editor::fillSelection() {
+    MapPixmapItem *item = getBlockEditingItem();
+    if (!item || item->selection.isEmpty()) {
+        return;
+    }
+    quint16 mask;
+    BlockBuffer pattern = getFillPattern(&mask);
+    map->fillBlocks(item->selection, &pattern, mask);
+    redrawBlocks();
+}
+
+void Editor::selectAllBlocks() {
+    MapPixmapItem *item = getBlockEditingItem();
+    if (!item) {
+        return;
+    }
+    item->selection = QRect(0, 0, map->getWidth(), map->getHeight());
+    item->update();
+}
+
+void Editor::redrawBlocks() {
+    map_item->draw();
+    collision_item->draw();
+}
+
+int Editor::frameInterval() {
+    QScreen *screen = QGuiApplication::primaryScreen();
+    qreal refreshRate = screen ? screen->refreshRate() : 60;
+    return qMax(1, qRound(1000 / qMax(refreshRate, qreal(1))));
 }
 
 void Editor::displayMetatiles() {
+    TRACE_ZONE("Editor::displayMetatiles", "scene");
     if (metatiles_item && metatiles_item->scene()) {
         metatiles_item->scene()->removeItem(metatiles_item);
         delete metatiles_item;
     }
 
-    scene_metatiles = new QGraphicsScene;
+    if (!scene_metatiles) {
+        scene_metatiles = new QGraphicsScene;
+    }
     metatiles_item = new MetatilesPixmapItem(map);
     metatiles_item->draw();
     scene_metatiles->addItem(metatiles_item);
 }
 
 void Editor::displayBorderMetatiles() {
+    TRACE_ZONE("Editor::displayBorderMetatiles", "scene");
     if (selected_border_metatiles_item && selected_border_metatiles_item->scene()) {
         selected_border_metatiles_item->scene()->removeItem(selected_border_metatiles_item);
         delete selected_border_metatiles_item;
     }
 
-    scene_selected_border_metatiles = new QGraphicsScene;
+    if (!scene_selected_border_metatiles) {
+        scene_selected_border_metatiles = new QGraphicsScene;
+    }
     selected_border_metatiles_item = new BorderMetatilesPixmapItem(map);
     selected_border_metatiles_item->draw();
     scene_selected_border_metatiles->addItem(selected_border_metatiles_item);
@@ -464,7 +657,9 @@ void Editor::displayCurrentMetatilesSelection() {
         delete scene_current_metatile_selection_item;
     }
 
-    scene_current_metatile_selection = new QGraphicsScene;
+    if (!scene_current_metatile_selection) {
+        scene_current_metatile_selection = new QGraphicsScene;
+    }
     scene_current_metatile_selection_item = new CurrentSelectedMetatilesPixmapItem(map);
     scene_current_metatile_selection_item->draw();
     scene_current_metatile_selection->addItem(scene_current_metatile_selection_item);
@@ -478,18 +673,22 @@ void Editor::redrawCurrentMetatilesSelection() {
 }
 
 void Editor::displayCollisionMetatiles() {
+    TRACE_ZONE("Editor::displayCollisionMetatiles", "scene");
     if (collision_metatiles_item && collision_metatiles_item->scene()) {
         collision_metatiles_item->scene()->removeItem(collision_metatiles_item);
         delete collision_metatiles_item;
     }
 
-    scene_collision_metatiles = new QGraphicsScene;
+    if (!scene_collision_metatiles) {
+        scene_collision_metatiles = new QGraphicsScene;
+    }
     collision_metatiles_item = new MovementPermissionsPixmapItem(map);
     collision_metatiles_item->draw();
     scene_collision_metatiles->addItem(collision_metatiles_item);
 }
 
 void Editor::displayMapEvents() {
+    TRACE_ZONE("Editor::displayMapEvents", "scene");
     if (events_group) {
         for (QGraphicsItem *child : events_group->childItems()) {
             events_group->removeFromGroup(child);
@@ -508,15 +707,50 @@ void Editor::displayMapEvents() {
     events_group = new EventGroup;
     scene->addItem(events_group);
 
+    // Events show their placeholder icons until their sprites are loaded.
     QList<Event *> events = map->getAllEvents();
-    project->loadEventPixmaps(events);
+    QStringList sprites = project->applyEventPixmaps(events);
     for (Event *event : events) {
         addMapEvent(event);
     }
+    scene_events = events;
     //objects_group->setFiltersChildEvents(false);
     events_group->setHandlesChildEvents(false);
 
     emit objectsChanged();
+
+    if (!sprites.isEmpty()) {
+        loadEventSprites(sprites);
+    }
+}
+
+// Decodes sprites on another thread, then swaps them into whichever of their events are on screen.
+void Editor::loadEventSprites(QStringList sprites) {
+    Project *project = this->project;
+    QFutureWatcher<QMap<QString, QImage>> *watcher = new QFutureWatcher<QMap<QString, QImage>>(this);
+    connect(watcher, &QFutureWatcher<QMap<QString, QImage>>::finished, [=]() {
+        watcher->deleteLater();
+        if (project != this->project) {
+            return;
+        }
+        project->cacheEventObjectSpriteImages(watcher->result());
+        if (!map || !events_group) {
+            return;
+        }
+        for (QGraphicsItem *child : events_group->childItems()) {
+            DraggablePixmapItem *item = (DraggablePixmapItem *)child;
+            if (item->event->get("event_type") != EventType::Object || !sprites.contains(item->event->get("sprite"))) {
+                continue;
+            }
+            project->applyEventPixmaps(QList<Event*>() << item->event);
+            redrawObject(item);
+            item->updatePosition();
+            emit item->spriteChanged(item->event->pixmap);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([project, sprites]() {
+        return project->readEventObjectSpriteImages(sprites);
+    }));
 }
 
 DraggablePixmapItem *Editor::addMapEvent(Event *event) {
@@ -526,6 +760,7 @@ DraggablePixmapItem *Editor::addMapEvent(Event *event) {
 }
 
 void Editor::displayMapConnections() {
+    TRACE_ZONE("Editor::displayMapConnections", "scene");
     for (QGraphicsPixmapItem* item : connection_items) {
         if (item->scene()) {
             item->scene()->removeItem(item);
@@ -553,9 +788,27 @@ void Editor::displayMapConnections() {
     if (!connection_edit_items.empty()) {
         onConnectionItemSelected(connection_edit_items.first());
     }
+    scene_connections = getConnectionsKey();
+}
+
+// Connections are edited in place, so they're compared by value as well as by identity.
+QStringList Editor::getConnectionsKey() {
+    QStringList key;
+    for (Connection *connection : map->connections) {
+        key << QString("%1 %2 %3 %4").arg(quintptr(connection)).arg(connection->direction).arg(connection->offset).arg(connection->map_name);
+    }
+    return key;
+}
+
+// Rebuilds the connection items only if the connections changed since they were built.
+void Editor::updateMapConnections() {
+    if (getConnectionsKey() != scene_connections) {
+        displayMapConnections();
+    }
 }
 
 void Editor::createConnectionItem(Connection* connection, bool hide) {
+    TRACE_ZONE("Editor::createConnectionItem", "scene");
     Map *connected_map = project->getMap(connection->map_name);
     QPixmap pixmap = connected_map->renderConnection(*connection);
     int offset = connection->offset.toInt(nullptr, 0);
@@ -594,6 +847,7 @@ void Editor::createConnectionItem(Connection* connection, bool hide) {
 }
 
 void Editor::displayMapBorder() {
+    TRACE_ZONE("Editor::displayMapBorder", "scene");
     for (QGraphicsPixmapItem* item : borderItems) {
         if (item->scene()) {
             item->scene()->removeItem(item);
@@ -615,6 +869,7 @@ void Editor::displayMapBorder() {
 }
 
 void Editor::displayMapGrid() {
+    TRACE_ZONE("Editor::displayMapGrid", "scene");
     for (QGraphicsLineItem* item : gridLines) {
         if (item && item->scene()) {
             item->scene()->removeItem(item);
@@ -622,7 +877,6 @@ void Editor::displayMapGrid() {
         delete item;
     }
     gridLines.clear();
-    ui->checkBox_ToggleGrid->disconnect();
 
     int pixelWidth = map->getWidth() * 16;
     int pixelHeight = map->getHeight() * 16;
@@ -631,14 +885,12 @@ void Editor::displayMapGrid() {
         QGraphicsLineItem *line = scene->addLine(x, 0, x, pixelHeight);
         line->setVisible(ui->checkBox_ToggleGrid->isChecked());
         gridLines.append(line);
-        connect(ui->checkBox_ToggleGrid, &QCheckBox::toggled, [=](bool checked){line->setVisible(checked);});
     }
     for (int j = 0; j <= map->getHeight(); j++) {
         int y = j * 16;
         QGraphicsLineItem *line = scene->addLine(0, y, pixelWidth, y);
         line->setVisible(ui->checkBox_ToggleGrid->isChecked());
         gridLines.append(line);
-        connect(ui->checkBox_ToggleGrid, &QCheckBox::toggled, [=](bool checked){line->setVisible(checked);});
     }
 }
 
@@ -650,6 +902,7 @@ void Editor::updateConnectionOffset(int offset) {
     offset = qMin(offset, selected_connection_item->getMaxOffset());
     offset = qMax(offset, selected_connection_item->getMinOffset());
     selected_connection_item->connection->offset = QString::number(offset);
+    map->has_unsaved_changes = true;
     if (selected_connection_item->connection->direction == "up" || selected_connection_item->connection->direction == "down") {
         selected_connection_item->setX(selected_connection_item->initialX + (offset - selected_connection_item->initialOffset) * 16);
     } else if (selected_connection_item->connection->direction == "left" || selected_connection_item->connection->direction == "right") {
@@ -705,6 +958,7 @@ void Editor::addNewConnection() {
     newConnection->offset = "0";
     newConnection->map_name = defaultMapName;
     map->connections.append(newConnection);
+    map->has_unsaved_changes = true;
     createConnectionItem(newConnection, true);
     onConnectionItemSelected(connection_edit_items.last());
     ui->label_NumConnections->setText(QString::number(map->connections.length()));
@@ -747,6 +1001,7 @@ void Editor::updateMirroredConnection(Connection* connection, QString originalDi
     if (isDelete) {
         if (mirrorConnection) {
             otherMap->connections.removeOne(mirrorConnection);
+            otherMap->has_unsaved_changes = true;
             delete mirrorConnection;
         }
         return;
@@ -755,6 +1010,7 @@ void Editor::updateMirroredConnection(Connection* connection, QString originalDi
     if (connection->direction != originalDirection || connection->map_name != originalMapName) {
         if (mirrorConnection) {
             otherMap->connections.removeOne(mirrorConnection);
+            otherMap->has_unsaved_changes = true;
             delete mirrorConnection;
             mirrorConnection = NULL;
             otherMap = project->getMap(connection->map_name);
@@ -770,6 +1026,7 @@ void Editor::updateMirroredConnection(Connection* connection, QString originalDi
     }
 
     mirrorConnection->offset = QString::number(-connection->offset.toInt());
+    otherMap->has_unsaved_changes = true;
 }
 
 void Editor::removeCurrentConnection() {
@@ -777,6 +1034,7 @@ void Editor::removeCurrentConnection() {
         return;
 
     map->connections.removeOne(selected_connection_item->connection);
+    map->has_unsaved_changes = true;
     connection_edit_items.removeOne(selected_connection_item);
     removeMirroredConnection(selected_connection_item->connection);
 
@@ -838,6 +1096,7 @@ void Editor::updateDiveEmergeMap(QString mapName, QString direction) {
         }
     }
 
+    map->has_unsaved_changes = true;
     ui->label_NumConnections->setText(QString::number(map->connections.length()));
 }
 
@@ -847,6 +1106,7 @@ void Editor::updatePrimaryTileset(QString tilesetLabel)
     {
         map->layout->tileset_primary_label = tilesetLabel;
         map->layout->tileset_primary = project->getTileset(tilesetLabel);
+        map->layout->has_unsaved_changes = true;
         emit tilesetChanged(map->name);
     }
 }
@@ -857,6 +1117,7 @@ void Editor::updateSecondaryTileset(QString tilesetLabel)
     {
         map->layout->tileset_secondary_label = tilesetLabel;
         map->layout->tileset_secondary = project->getTileset(tilesetLabel);
+        map->layout->has_unsaved_changes = true;
         emit tilesetChanged(map->name);
     }
 }
@@ -874,10 +1135,14 @@ void MetatilesPixmapItem::updateCurHoveredMetatile(QPointF pos) {
     int y = ((int)pos.y()) / 16;
     int width = pixmap().width() / 16;
     int height = pixmap().height() / 16;
-    if (x < 0 || x >= width || y < 0 || y >= height) {
+    int block = (x < 0 || x >= width || y < 0 || y >= height) ? -1 : y * width + x;
+    if (block == hovered_metatile) {
+        return;
+    }
+    hovered_metatile = block;
+    if (block < 0) {
         map->clearHoveredMetatile();
     } else {
-        int block = y * width + x;
         map->hoveredMetatileChanged(block);
     }
 }
@@ -886,6 +1151,7 @@ void MetatilesPixmapItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event) {
     updateCurHoveredMetatile(event->pos());
 }
 void MetatilesPixmapItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *event) {
+    hovered_metatile = -1;
     map->clearHoveredMetatile();
 }
 void MetatilesPixmapItem::mousePressEvent(QGraphicsSceneMouseEvent *event) {
@@ -1011,6 +1277,10 @@ void MovementPermissionsPixmapItem::updateCurHoveredMetatile(QPointF pos) {
     if (x >= width) x = width - 1;
     if (y < 0) y = 0;
     if (y >= height) y = height - 1;
+    if (y * width + x == hovered_metatile) {
+        return;
+    }
+    hovered_metatile = y * width + x;
     map->hoveredMovementPermissionTileChanged(x, y);
 }
 
@@ -1073,21 +1343,80 @@ void ConnectionPixmapItem::mouseDoubleClickEvent(QGraphicsSceneMouseEvent*) {
 void MapPixmapItem::paint(QGraphicsSceneMouseEvent *event) {
     if (map) {
         if (event->type() == QEvent::GraphicsSceneMouseRelease) {
+            endStroke();
             map->commit();
         } else {
-            QPointF pos = event->pos();
-            int x = (int)(pos.x()) / 16;
-            int y = (int)(pos.y()) / 16;
+            queueStroke(event);
+        }
+    }
+}
 
-            // Paint onto the map.
-            if (map->smart_paths_enabled && map->selected_metatiles_width == 3 && map->selected_metatiles_height == 3) {
-                paintSmartPath(x, y);
-            } else {
-                paintNormal(x, y);
+// Queues the cells between the last position and this one, so fast strokes don't skip any.
+void MapPixmapItem::queueStroke(QGraphicsSceneMouseEvent *event) {
+    QPointF pos = event->pos();
+    QPoint cell((int)(pos.x()) / 16, (int)(pos.y()) / 16);
+    if (!stroking || event->type() == QEvent::GraphicsSceneMousePress) {
+        pending_stroke.append(cell);
+    } else if (cell != last_stroke_pos) {
+        // Bresenham's line, leaving out the start, which was queued last time.
+        int dx = qAbs(cell.x() - last_stroke_pos.x());
+        int dy = -qAbs(cell.y() - last_stroke_pos.y());
+        int sx = last_stroke_pos.x() < cell.x() ? 1 : -1;
+        int sy = last_stroke_pos.y() < cell.y() ? 1 : -1;
+        int error = dx + dy;
+        QPoint point = last_stroke_pos;
+        while (point != cell) {
+            if (error * 2 >= dy) {
+                error += dy;
+                point.rx() += sx;
+            }
+            if (error * 2 <= dx) {
+                error += dx;
+                point.ry() += sy;
             }
+            pending_stroke.append(point);
         }
+    }
+    last_stroke_pos = cell;
+    stroking = true;
 
-        draw();
+    if (!stroke_timer) {
+        stroke_timer = new QTimer(this);
+        stroke_timer->setSingleShot(true);
+        connect(stroke_timer, &QTimer::timeout, [this]() {
+            flushStroke();
+        });
+    }
+    if (!stroke_timer->isActive()) {
+        stroke_timer->start(Editor::frameInterval());
+    }
+}
+
+// Applies every queued cell, then renders once.
+void MapPixmapItem::flushStroke() {
+    if (stroke_timer) {
+        stroke_timer->stop();
+    }
+    if (pending_stroke.isEmpty() || !map) {
+        return;
+    }
+    for (QPoint cell : pending_stroke) {
+        applyStroke(cell.x(), cell.y());
+    }
+    pending_stroke.clear();
+    draw();
+}
+
+void MapPixmapItem::endStroke() {
+    flushStroke();
+    stroking = false;
+}
+
+void MapPixmapItem::applyStroke(int x, int y) {
+    if (map->smart_paths_enabled && map->selected_metatiles_width == 3 && map->selected_metatiles_height == 3) {
+        paintSmartPath(x, y);
+    } else {
+        paintNormal(x, y);
     }
 }
 
@@ -1107,7 +1436,7 @@ void MapPixmapItem::paintNormal(int x, int y) {
         int actualY = j + y;
         Block *block = map->getBlock(actualX, actualY);
         if (block) {
-            block->tile = map->selected_metatiles->at(j * map->selected_metatiles_width + i);
+            map->paintSelectedBlock(j * map->selected_metatiles_width + i, block);
             map->_setBlock(actualX, actualY, *block);
         }
     }
@@ -1194,7 +1523,7 @@ void MapPixmapItem::paintSmartPath(int x, int y) {
         if (left && IS_SMART_PATH_TILE(left))
             id += 8;
 
-        block->tile = map->selected_metatiles->at(smartPathTable[id]);
+        map->paintSelectedBlock(smartPathTable[id], block);
         map->_setBlock(actualX, actualY, *block);
     }
 }
@@ -1213,38 +1542,15 @@ void MapPixmapItem::updateMetatileSelection(QGraphicsSceneMouseEvent *event) {
     // Update/apply copied metatiles.
     if (event->type() == QEvent::GraphicsSceneMousePress) {
         selection_origin = QPoint(x, y);
-        selection.clear();
-        selection.append(QPoint(x, y));
-        editor->copiedMetatileSelectionWidth = 1;
-        editor->copiedMetatileSelectionHeight = 1;
-    } else if (event->type() == QEvent::GraphicsSceneMouseMove) {
-        QPoint pos = QPoint(x, y);
-        int x1 = selection_origin.x();
-        int y1 = selection_origin.y();
-        int x2 = pos.x();
-        int y2 = pos.y();
-        if (x1 > x2) SWAP(x1, x2);
-        if (y1 > y2) SWAP(y1, y2);
-        selection.clear();
-        for (int y = y1; y <= y2; y++) {
-            for (int x = x1; x <= x2; x++) {
-                selection.append(QPoint(x, y));
-            }
-        }
-
-        editor->copiedMetatileSelectionWidth = x2 - x1 + 1;
-        editor->copiedMetatileSelectionHeight = y2 - y1 + 1;
     }
-
-    editor->copiedMetatileSelection->clear();
-    for (QPoint point : selection) {
-        editor->copiedMetatileSelection->append(map->getBlock(point.x(), point.y())->tile);
+    BlockBuffer blocks = map->copyBlocks(QRect(selection_origin, QPoint(x, y)).normalized());
+    if (blocks.isEmpty()) {
+        return;
     }
-
+    // The picked blocks are painted whole, so their collision and elevation come along.
+    editor->copiedMetatileSelection = blocks;
     editor->lastSelectedMetatilesFromMap = true;
-    map->selected_metatiles_width = editor->copiedMetatileSelectionWidth;
-    map->selected_metatiles_height = editor->copiedMetatileSelectionHeight;
-    *map->selected_metatiles = *editor->copiedMetatileSelection;
+    map->setSelectedBlocks(blocks);
 
     editor->redrawCurrentMetatilesSelection();
 }
@@ -1258,8 +1564,9 @@ void MapPixmapItem::floodFill(QGraphicsSceneMouseEvent *event) {
             int x = (int)(pos.x()) / 16;
             int y = (int)(pos.y()) / 16;
             Block *block = map->getBlock(x, y);
-            int tile = map->selected_metatiles->first();
-            if (block && block->tile != tile) {
+            Block painted = block ? *block : Block();
+            map->paintSelectedBlock(0, &painted);
+            if (block && painted != *block) {
                 if (map->smart_paths_enabled && map->selected_metatiles_width == 3 && map->selected_metatiles_height == 3)
                     this->_floodFillSmartPath(x, y);
                 else
@@ -1290,13 +1597,13 @@ void MapPixmapItem::_floodFill(int initialX, int initialY) {
         int j = yDiff % map->selected_metatiles_height;
         if (i < 0) i = map->selected_metatiles_width + i;
         if (j < 0) j = map->selected_metatiles_height + j;
-        int tile = map->selected_metatiles->at(j * map->selected_metatiles_width + i);
-        uint old_tile = block->tile;
-        if (old_tile == tile) {
+        Block old_block = *block;
+        map->paintSelectedBlock(j * map->selected_metatiles_width + i, block);
+        if (*block == old_block) {
             continue;
         }
 
-        block->tile = tile;
+        uint old_tile = old_block.tile;
         map->_setBlock(x, y, *block);
         if ((block = map->getBlock(x + 1, y)) && block->tile == old_tile) {
             todo.append(QPoint(x + 1, y));
@@ -1388,7 +1695,7 @@ void MapPixmapItem::_floodFillSmartPath(int initialX, int initialY) {
         if (left && IS_SMART_PATH_TILE(left))
             id += 8;
 
-        block->tile = map->selected_metatiles->at(smartPathTable[id]);
+        map->paintSelectedBlock(smartPathTable[id], block);
         map->_setBlock(x, y, *block);
 
         // Visit neighbors if they are smart-path tiles, and don't revisit any.
@@ -1426,36 +1733,41 @@ void MapPixmapItem::pick(QGraphicsSceneMouseEvent *event) {
     }
 }
 
+// Dragging outside the selection selects a new rectangle. Dragging inside it moves its blocks.
 void MapPixmapItem::select(QGraphicsSceneMouseEvent *event) {
     QPointF pos = event->pos();
-    int x = (int)(pos.x()) / 16;
-    int y = (int)(pos.y()) / 16;
+    int x = qBound(0, (int)(pos.x()) / 16, map->getWidth() - 1);
+    int y = qBound(0, (int)(pos.y()) / 16, map->getHeight() - 1);
+    QPoint cell(x, y);
     if (event->type() == QEvent::GraphicsSceneMousePress) {
-        selection_origin = QPoint(x, y);
-        selection.clear();
+        moving_selection = selection.contains(cell);
+        move_origin = cell;
+        move_offset = QPoint();
+        if (!moving_selection) {
+            selection_origin = cell;
+            selection = QRect(cell, cell);
+        }
     } else if (event->type() == QEvent::GraphicsSceneMouseMove) {
-        if (event->buttons() & Qt::LeftButton) {
-            selection.clear();
-            selection.append(QPoint(x, y));
+        if (!(event->buttons() & Qt::LeftButton)) {
+            return;
+        }
+        if (moving_selection) {
+            move_offset = cell - move_origin;
+        } else {
+            selection = QRect(selection_origin, cell).normalized();
         }
     } else if (event->type() == QEvent::GraphicsSceneMouseRelease) {
-        if (!selection.isEmpty()) {
-            QPoint pos = selection.last();
-            int x1 = selection_origin.x();
-            int y1 = selection_origin.y();
-            int x2 = pos.x();
-            int y2 = pos.y();
-            if (x1 > x2) SWAP(x1, x2);
-            if (y1 > y2) SWAP(y1, y2);
-            selection.clear();
-            for (int y = y1; y <= y2; y++) {
-                for (int x = x1; x <= x2; x++) {
-                    selection.append(QPoint(x, y));
-                }
-            }
-            qDebug() << QString("selected (%1, %2) -> (%3, %4)").arg(x1).arg(y1).arg(x2).arg(y2);
+        if (moving_selection && !move_offset.isNull()) {
+            quint16 mask;
+            BlockBuffer fill = editor->getFillPattern(&mask);
+            map->moveBlocks(selection, selection.topLeft() + move_offset, &fill, mask);
+            selection = selection.translated(move_offset) & QRect(0, 0, map->getWidth(), map->getHeight());
+            editor->redrawBlocks();
         }
+        moving_selection = false;
+        move_offset = QPoint();
     }
+    update();
 }
 
 void MapPixmapItem::draw(bool ignoreCache) {
@@ -1464,29 +1776,92 @@ void MapPixmapItem::draw(bool ignoreCache) {
     }
 }
 
+// Zoomed out, the map is drawn from a downscaled copy, which is faster and doesn't alias.
+void MapPixmapItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) {
+    int level = Mipmaps::levelForDetail(option->levelOfDetailFromTransform(painter->worldTransform()));
+    QPixmap mipmap = level ? getMipmap(level) : QPixmap();
+    if (mipmap.isNull()) {
+        QGraphicsPixmapItem::paint(painter, option, widget);
+    } else {
+        painter->save();
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        painter->drawPixmap(QRectF(offset(), pixmap().size()), mipmap, QRectF(mipmap.rect()));
+        painter->restore();
+    }
+
+    if (!selection.isEmpty()) {
+        QRect rect = selection.translated(move_offset);
+        painter->save();
+        painter->setPen(QPen(Qt::white, 0, Qt::DashLine));
+        painter->setBrush(QColor(255, 255, 255, 48));
+        painter->drawRect(QRectF(rect.x() * 16, rect.y() * 16, rect.width() * 16, rect.height() * 16));
+        painter->restore();
+    }
+}
+
+QPixmap MapPixmapItem::getMipmap(int level) {
+    return map ? map->mipmaps.pixmap(level) : QPixmap();
+}
+
+void MapPixmapItem::setMap(Map *map_) {
+    if (map_ == map) {
+        return;
+    }
+    endStroke();
+    map = map_;
+    selection = QRect();
+    moving_selection = false;
+    move_offset = QPoint();
+    hovered_cell = QPoint(-1, -1);
+    hovered_value = -1;
+    hovered_view = NULL;
+}
+
+// Only updates the status bar when the cell under the cursor, or what's in it, changes.
 void MapPixmapItem::updateCurHoveredTile(QPointF pos) {
     int x = ((int)pos.x()) / 16;
     int y = ((int)pos.y()) / 16;
     int blockIndex = y * map->getWidth() + x;
     if (x < 0 || x >= map->getWidth() || y < 0 || y >= map->getHeight()) {
-        map->clearHoveredTile();
+        clearHoveredTile();
     } else {
+        Block block = map->layout->blockdata->blocks->at(blockIndex);
         if (editor->current_view == editor->map_item) {
-            int tile = map->layout->blockdata->blocks->at(blockIndex).tile;
-            map->hoveredTileChanged(x, y, tile);
+            if (QPoint(x, y) == hovered_cell && block.tile == hovered_value && hovered_view == editor->current_view) {
+                return;
+            }
+            hovered_cell = QPoint(x, y);
+            hovered_value = block.tile;
+            hovered_view = editor->current_view;
+            map->hoveredTileChanged(x, y, block.tile);
         } else if (editor->current_view == editor->collision_item) {
-            int collision = map->layout->blockdata->blocks->at(blockIndex).collision;
-            int elevation = map->layout->blockdata->blocks->at(blockIndex).elevation;
-            map->hoveredMovementPermissionTileChanged(collision, elevation);
+            int value = (block.collision << 8) | block.elevation;
+            if (QPoint(x, y) == hovered_cell && value == hovered_value && hovered_view == editor->current_view) {
+                return;
+            }
+            hovered_cell = QPoint(x, y);
+            hovered_value = value;
+            hovered_view = editor->current_view;
+            map->hoveredMovementPermissionTileChanged(block.collision, block.elevation);
         }
     }
 }
 
+void MapPixmapItem::clearHoveredTile() {
+    if (hovered_cell == QPoint(-1, -1)) {
+        return;
+    }
+    hovered_cell = QPoint(-1, -1);
+    hovered_value = -1;
+    hovered_view = NULL;
+    map->clearHoveredTile();
+}
+
 void MapPixmapItem::hoverMoveEvent(QGraphicsSceneHoverEvent *event) {
     updateCurHoveredTile(event->pos());
 }
 void MapPixmapItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *event) {
-    map->clearHoveredTile();
+    clearHoveredTile();
 }
 void MapPixmapItem::mousePressEvent(QGraphicsSceneMouseEvent *event) {
     QPointF pos = event->pos();
@@ -1520,25 +1895,30 @@ void CollisionPixmapItem::draw(bool ignoreCache) {
     }
 }
 
+QPixmap CollisionPixmapItem::getMipmap(int level) {
+    return map ? map->collision_mipmaps.pixmap(level) : QPixmap();
+}
+
 void CollisionPixmapItem::paint(QGraphicsSceneMouseEvent *event) {
     if (map) {
-        QPointF pos = event->pos();
-        int x = (int)(pos.x()) / 16;
-        int y = (int)(pos.y()) / 16;
-        Block *block = map->getBlock(x, y);
-        if (block) {
-            if (map->paint_collision >= 0) {
-                block->collision = map->paint_collision;
-            }
-            if (map->paint_elevation >= 0) {
-                block->elevation = map->paint_elevation;
-            }
-            map->_setBlock(x, y, *block);
-        }
+        queueStroke(event);
         if (event->type() == QEvent::GraphicsSceneMouseRelease) {
+            endStroke();
             map->commit();
         }
-        draw();
+    }
+}
+
+void CollisionPixmapItem::applyStroke(int x, int y) {
+    Block *block = map->getBlock(x, y);
+    if (block) {
+        if (map->paint_collision >= 0) {
+            block->collision = map->paint_collision;
+        }
+        if (map->paint_elevation >= 0) {
+            block->elevation = map->paint_elevation;
+        }
+        map->_setBlock(x, y, *block);
     }
 }
 
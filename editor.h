@@ -7,6 +7,7 @@
 #include <QGraphicsItemAnimation>
 #include <QComboBox>
 #include <QCheckBox>
+#include <QTimer>
 
 #include "project.h"
 #include "ui_mainwindow.h"
@@ -32,8 +33,9 @@ public:
     QObject *parent = NULL;
     Project *project = NULL;
     Map *map = NULL;
-    void saveProject();
-    void save();
+    qint64 last_display_map_ms = -1;
+    bool saveProject(std::function<void(int, int)> progress = nullptr);
+    bool save(std::function<void(int, int)> progress = nullptr);
     void undo();
     void redo();
     void setMap(QString map_name);
@@ -46,9 +48,25 @@ public:
     void displayCollisionMetatiles();
     void displayElevationMetatiles();
     void displayMapEvents();
+    void loadEventSprites(QStringList sprites);
     void displayMapConnections();
     void displayMapBorder();
     void displayMapGrid();
+    void updateMapConnections();
+    void invalidateMapScene();
+
+    // Rectangular block selections on the map and collision views. See MapPixmapItem::select().
+    MapPixmapItem *getBlockEditingItem();
+    BlockBuffer getFillPattern(quint16 *mask);
+    void copySelection();
+    void cutSelection();
+    void pasteBlocks();
+    void fillSelection();
+    void selectAllBlocks();
+    void redrawBlocks();
+
+    // Milliseconds between display refreshes, for work that only needs doing once per frame.
+    static int frameInterval();
 
     void setEditingMap();
     void setEditingCollision();
@@ -103,9 +121,8 @@ public:
     QList<DraggablePixmapItem*> *selected_events = NULL;
 
     bool lastSelectedMetatilesFromMap = false;
-    int copiedMetatileSelectionWidth = 0;
-    int copiedMetatileSelectionHeight = 0;
-    QList<int> *copiedMetatileSelection = new QList<int>;
+    // The blocks last picked from a map, kept for the next map that's opened.
+    BlockBuffer copiedMetatileSelection;
 
     QString map_edit_mode;
 
@@ -114,6 +131,14 @@ public:
     void objectsView_onMouseRelease(QMouseEvent *event);
 
 private:
+    // What the map scene was last built from. displayMap() only rebuilds the parts whose inputs changed.
+    Map *scene_map = NULL;
+    QSize scene_size;
+    QPair<Tileset*, Tileset*> scene_tilesets;
+    QList<Event*> scene_events;
+    QStringList scene_connections;
+    QStringList getConnectionsKey();
+
     void setConnectionItemsVisible(bool);
     void setBorderItemsVisible(bool, qreal = 1);
     void setConnectionEditControlValues(Connection*);
@@ -263,7 +288,14 @@ public:
     bool active;
     bool right_click;
     QPoint selection_origin;
-    QList<QPoint> selection;
+    QRect selection;
+    // While the selection is being dragged somewhere else.
+    bool moving_selection = false;
+    QPoint move_origin;
+    QPoint move_offset;
+    QPoint getHoveredCell() {
+        return hovered_cell;
+    }
     virtual void paint(QGraphicsSceneMouseEvent*);
     virtual void floodFill(QGraphicsSceneMouseEvent*);
     void _floodFill(int x, int y);
@@ -272,8 +304,31 @@ public:
     virtual void select(QGraphicsSceneMouseEvent*);
     virtual void draw(bool ignoreCache = false);
     void updateMetatileSelection(QGraphicsSceneMouseEvent *event);
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+    virtual QPixmap getMipmap(int level);
+    void setMap(Map *map_);
+
+protected:
+    // Paint strokes are queued and applied once per frame, so fast drags don't render on every mouse event.
+    void queueStroke(QGraphicsSceneMouseEvent *event);
+    void flushStroke();
+    void endStroke();
+    virtual void applyStroke(int x, int y);
 
 private:
+    QList<QPoint> pending_stroke;
+    QPoint last_stroke_pos;
+    bool stroking = false;
+    QTimer *stroke_timer = NULL;
+
+    // What the status bar last said was under the cursor, so moves within a cell don't update it again.
+    // The value is the metatile on the map view, and collision and elevation on the collision view,
+    // so it only counts for the view it was read in.
+    QPoint hovered_cell = QPoint(-1, -1);
+    int hovered_value = -1;
+    QGraphicsPixmapItem *hovered_view = NULL;
+    void clearHoveredTile();
+
     void updateCurHoveredTile(QPointF pos);
     void paintNormal(int x, int y);
     void paintSmartPath(int x, int y);
@@ -302,6 +357,10 @@ public:
     virtual void floodFill(QGraphicsSceneMouseEvent*);
     virtual void pick(QGraphicsSceneMouseEvent*);
     virtual void draw(bool ignoreCache = false);
+    virtual QPixmap getMipmap(int level);
+
+protected:
+    virtual void applyStroke(int x, int y);
 
 signals:
     void mouseEvent(QGraphicsSceneMouseEvent *, CollisionPixmapItem *);
@@ -369,6 +428,7 @@ private:
     void updateSelection(QPointF pos);
 protected:
     virtual void updateCurHoveredMetatile(QPointF pos);
+    int hovered_metatile = -1;
 private slots:
     void paintTileChanged(Map *map);
 protected:
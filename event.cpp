@@ -8,8 +8,11 @@ QString EventType::Sign = "event_sign";
 QString EventType::HiddenItem = "event_hidden_item";
 QString EventType::SecretBase = "event_secret_base";
 
+quint64 Event::lastRevision = 0;
+
 Event::Event()
 {
+    revision = ++lastRevision;
 }
 
 Event* Event::createNewEvent(QString event_type, QString map_name)
@@ -113,98 +116,84 @@ Event* Event::createNewSecretBaseEvent()
     return event;
 }
 
-QString Event::buildObjectEventMacro(int item_index)
+void Event::buildObjectEventMacro(TextWriter *writer, int item_index)
 {
     int radius_x = this->getInt("radius_x");
     int radius_y = this->getInt("radius_y");
     uint16_t x = this->getInt("x");
     uint16_t y = this->getInt("y");
 
-    QString text = "";
-    text += QString("\tobject_event %1").arg(item_index + 1);
-    text += QString(", %1").arg(this->get("sprite"));
-    text += QString(", %1").arg(this->get("replacement"));
-    text += QString(", %1").arg(x);
-    text += QString(", %1").arg(y);
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("movement_type"));
-    text += QString(", %1").arg(radius_x);
-    text += QString(", %1").arg(radius_y);
-    text += QString(", %1").arg(this->get("is_trainer"));
-    text += QString(", %1").arg(this->get("sight_radius_tree_id"));
-    text += QString(", %1").arg(this->get("script_label"));
-    text += QString(", %1").arg(this->get("event_flag"));
-    text += "\n";
-    return text;
-}
-
-QString Event::buildWarpEventMacro(QMap<QString, QString> *mapNamesToMapConstants)
-{
-    QString text = "";
-    text += QString("\twarp_def %1").arg(this->get("x"));
-    text += QString(", %1").arg(this->get("y"));
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("destination_warp"));
-    text += QString(", %1").arg(mapNamesToMapConstants->value(this->get("destination_map_name")));
-    text += "\n";
-    return text;
-}
-
-QString Event::buildCoordScriptEventMacro()
-{
-    QString text = "";
-    text += QString("\tcoord_event %1").arg(this->get("x"));
-    text += QString(", %1").arg(this->get("y"));
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("script_var"));
-    text += QString(", %1").arg(this->get("script_var_value"));
-    text += QString(", %1").arg(this->get("script_label"));
-    text += "\n";
-    return text;
-}
-
-QString Event::buildCoordWeatherEventMacro()
-{
-    QString text = "";
-    text += QString("\tcoord_weather_event %1").arg(this->get("x"));
-    text += QString(", %1").arg(this->get("y"));
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("weather"));
-    text += "\n";
-    return text;
-}
-
-QString Event::buildSignEventMacro()
-{
-    QString text = "";
-    text += QString("\tbg_event %1").arg(this->get("x"));
-    text += QString(", %1").arg(this->get("y"));
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("player_facing_direction"));
-    text += QString(", %1").arg(this->get("script_label"));
-    text += "\n";
-    return text;
-}
-
-QString Event::buildHiddenItemEventMacro()
-{
-    QString text = "";
-    text += QString("\tbg_hidden_item_event %1").arg(this->get("x"));
-    text += QString(", %1").arg(this->get("y"));
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("item"));
-    text += QString(", %1").arg(this->get("flag"));
-    text += "\n";
-    return text;
-}
-
-QString Event::buildSecretBaseEventMacro()
-{
-    QString text = "";
-    text += QString("\tbg_secret_base_event %1").arg(this->get("x"));
-    text += QString(", %1").arg(this->get("y"));
-    text += QString(", %1").arg(this->get("elevation"));
-    text += QString(", %1").arg(this->get("secret_base_id"));
-    text += "\n";
-    return text;
+    *writer << "\tobject_event " << item_index + 1;
+    *writer << ", " << this->get("sprite");
+    *writer << ", " << this->get("replacement");
+    *writer << ", " << x;
+    *writer << ", " << y;
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("movement_type");
+    *writer << ", " << radius_x;
+    *writer << ", " << radius_y;
+    *writer << ", " << this->get("is_trainer");
+    *writer << ", " << this->get("sight_radius_tree_id");
+    *writer << ", " << this->get("script_label");
+    *writer << ", " << this->get("event_flag");
+    *writer << "\n";
+}
+
+void Event::buildWarpEventMacro(TextWriter *writer, QMap<QString, QString> *mapNamesToMapConstants)
+{
+    *writer << "\twarp_def " << this->get("x");
+    *writer << ", " << this->get("y");
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("destination_warp");
+    *writer << ", " << mapNamesToMapConstants->value(this->get("destination_map_name"));
+    *writer << "\n";
+}
+
+void Event::buildCoordScriptEventMacro(TextWriter *writer)
+{
+    *writer << "\tcoord_event " << this->get("x");
+    *writer << ", " << this->get("y");
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("script_var");
+    *writer << ", " << this->get("script_var_value");
+    *writer << ", " << this->get("script_label");
+    *writer << "\n";
+}
+
+void Event::buildCoordWeatherEventMacro(TextWriter *writer)
+{
+    *writer << "\tcoord_weather_event " << this->get("x");
+    *writer << ", " << this->get("y");
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("weather");
+    *writer << "\n";
+}
+
+void Event::buildSignEventMacro(TextWriter *writer)
+{
+    *writer << "\tbg_event " << this->get("x");
+    *writer << ", " << this->get("y");
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("player_facing_direction");
+    *writer << ", " << this->get("script_label");
+    *writer << "\n";
+}
+
+void Event::buildHiddenItemEventMacro(TextWriter *writer)
+{
+    *writer << "\tbg_hidden_item_event " << this->get("x");
+    *writer << ", " << this->get("y");
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("item");
+    *writer << ", " << this->get("flag");
+    *writer << "\n";
+}
+
+void Event::buildSecretBaseEventMacro(TextWriter *writer)
+{
+    *writer << "\tbg_secret_base_event " << this->get("x");
+    *writer << ", " << this->get("y");
+    *writer << ", " << this->get("elevation");
+    *writer << ", " << this->get("secret_base_id");
+    *writer << "\n";
 }
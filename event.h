@@ -5,6 +5,7 @@
 #include <QPixmap>
 #include <QMap>
 #include <QDebug>
+#include "textwriter.h"
 
 class EventType
 {
@@ -49,6 +50,7 @@ public:
     }
     void put(QString key, QString value) {
         values.insert(key, value);
+        revision = ++lastRevision;
     }
 
     static Event* createNewEvent(QString, QString);
@@ -60,16 +62,21 @@ public:
     static Event* createNewHiddenItemEvent();
     static Event* createNewSecretBaseEvent();
 
-    QString buildObjectEventMacro(int);
-    QString buildWarpEventMacro(QMap<QString, QString>*);
-    QString buildCoordScriptEventMacro();
-    QString buildCoordWeatherEventMacro();
-    QString buildSignEventMacro();
-    QString buildHiddenItemEventMacro();
-    QString buildSecretBaseEventMacro();
+    void buildObjectEventMacro(TextWriter*, int);
+    void buildWarpEventMacro(TextWriter*, QMap<QString, QString>*);
+    void buildCoordScriptEventMacro(TextWriter*);
+    void buildCoordWeatherEventMacro(TextWriter*);
+    void buildSignEventMacro(TextWriter*);
+    void buildHiddenItemEventMacro(TextWriter*);
+    void buildSecretBaseEventMacro(TextWriter*);
 
     QMap<QString, QString> values;
     QPixmap pixmap;
+
+    // Changes every time the event is edited, and no two events ever share one,
+    // so comparing revisions is enough to tell whether a map's events changed.
+    quint64 revision;
+    static quint64 lastRevision;
 };
 
 #endif // EVENT_H
@@ -0,0 +1,195 @@
+#include "journal.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+const quint32 Journal::magic = 0x524a4d50; // "PMJR"
+const quint32 Journal::version = 2;
+
+Journal::Journal(QString path)
+{
+    this->path = path;
+}
+
+Journal::~Journal()
+{
+    mutex.lock();
+    stopping = true;
+    condition.wakeAll();
+    mutex.unlock();
+    wait();
+}
+
+QString Journal::pathForProject(QString root) {
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QString id = QCryptographicHash::hash(QDir(root).absolutePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QString("%1/journals/%2.journal").arg(dir).arg(id);
+}
+
+// Each record is stored as its length and checksum followed by the record itself,
+// so a record cut short by a crash can be recognized and ignored.
+QList<Journal::Record> Journal::read(QString path) {
+    QList<Record> records;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return records;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 fileMagic, fileVersion;
+    in >> fileMagic >> fileVersion;
+    if (in.status() != QDataStream::Ok || fileMagic != magic || fileVersion != version) {
+        return records;
+    }
+
+    while (!in.atEnd()) {
+        quint32 length;
+        quint16 checksum;
+        in >> length >> checksum;
+        if (in.status() != QDataStream::Ok || length > file.size()) {
+            break;
+        }
+        QByteArray payload(int(length), 0);
+        if (in.readRawData(payload.data(), int(length)) != int(length)
+         || qChecksum(payload.constData(), length) != checksum) {
+            qDebug() << QString("Ignoring incomplete record at the end of journal '%1'").arg(path);
+            break;
+        }
+        QDataStream record_in(payload);
+        record_in.setVersion(QDataStream::Qt_5_0);
+        Record record;
+        qint32 type;
+        record_in >> type >> record.map_name >> record.base >> record.data;
+        record.type = type;
+        records.append(record);
+    }
+    return records;
+}
+
+void Journal::append(Record record) {
+    QMutexLocker locker(&mutex);
+    Operation operation;
+    operation.record = record;
+    queue.append(operation);
+    condition.wakeAll();
+}
+
+// Drops every record for these maps, e.g. once they've been saved.
+void Journal::discard(QStringList map_names) {
+    if (map_names.isEmpty()) {
+        return;
+    }
+    QMutexLocker locker(&mutex);
+    Operation operation;
+    operation.discard = map_names;
+    queue.append(operation);
+    condition.wakeAll();
+}
+
+void Journal::run() {
+    while (true) {
+        mutex.lock();
+        if (queue.isEmpty() && !stopping) {
+            condition.wait(&mutex);
+        }
+        QList<Operation> operations = queue;
+        bool stop = stopping;
+        queue.clear();
+        mutex.unlock();
+
+        QList<Record> records;
+        for (Operation operation : operations) {
+            if (!operation.discard.isEmpty()) {
+                writeRecords(records);
+                records.clear();
+                rewriteWithout(operation.discard);
+            } else {
+                records.append(operation.record);
+            }
+        }
+        writeRecords(records);
+
+        if (stop) {
+            break;
+        }
+    }
+}
+
+void Journal::writeRecords(QList<Record> records) {
+    if (records.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    if (!file.open(QIODevice::Append)) {
+        qDebug() << QString("Could not open journal '%1': ").arg(path) + file.errorString();
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    if (file.size() == 0) {
+        out << magic << version;
+    }
+    for (Record record : records) {
+        writeRecord(&out, record);
+    }
+    // This runs on the journal's thread, so waiting for the disk here doesn't hold up editing.
+    // Without it, the records could still be lost with the machine's power.
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    fsync(file.handle());
+#endif
+}
+
+void Journal::writeRecord(QDataStream *out, Record record) {
+    QByteArray payload;
+    QDataStream record_out(&payload, QIODevice::WriteOnly);
+    record_out.setVersion(QDataStream::Qt_5_0);
+    record_out << qint32(record.type) << record.map_name << record.base << record.data;
+    *out << quint32(payload.length()) << qChecksum(payload.constData(), payload.length());
+    out->writeRawData(payload.constData(), payload.length());
+}
+
+void Journal::rewriteWithout(QStringList map_names) {
+    QList<Record> kept;
+    for (Record record : read(path)) {
+        if (!map_names.contains(record.map_name)) {
+            kept.append(record);
+        }
+    }
+    if (kept.isEmpty()) {
+        QFile::remove(path);
+        return;
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << QString("Could not compact journal '%1': ").arg(path) + file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << magic << version;
+    for (Record record : kept) {
+        writeRecord(&out, record);
+    }
+    if (!file.commit()) {
+        qDebug() << QString("Could not compact journal '%1': ").arg(path) + file.errorString();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QDataStream>
+
+// Append-only log of edits that haven't been saved yet, so they can be
+// recovered after pretmap exits without saving. Records are queued from the
+// GUI thread and written to disk by the journal's own thread, so recording
+// an edit never waits on the disk.
+class Journal : public QThread
+{
+public:
+    enum RecordType {
+        Blocks = 1,
+        Events = 2,
+    };
+
+    class Record {
+    public:
+        int type;
+        QString map_name;
+        // Hash of the map's files the edit was made on top of. See Project::hashMapSources().
+        QByteArray base;
+        QByteArray data;
+    };
+
+    Journal(QString path);
+    ~Journal();
+
+    static const quint32 magic;
+    static const quint32 version;
+    static QString pathForProject(QString root);
+    static QList<Record> read(QString path);
+
+    QString path;
+
+    void append(Record record);
+    void discard(QStringList map_names);
+
+protected:
+    void run() override;
+
+private:
+    // Appends and discards have to be applied in the order they were requested.
+    class Operation {
+    public:
+        Record record;
+        QStringList discard;
+    };
+
+    void writeRecords(QList<Record> records);
+    static void writeRecord(QDataStream *out, Record record);
+    void rewriteWithout(QStringList map_names);
+
+    QMutex mutex;
+    QWaitCondition condition;
+    QList<Operation> queue;
+    bool stopping = false;
+};
+
+#endif // JOURNAL_H
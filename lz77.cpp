@@ -0,0 +1,55 @@
+#include "lz77.h"
+
+#include <QDebug>
+
+QByteArray LZ77::decompress(QByteArray data) {
+    const uchar *src = reinterpret_cast<const uchar*>(data.constData());
+    int src_size = data.length();
+    if (src_size < 4 || src[0] != 0x10) {
+        qDebug() << "Data is not LZ77 compressed";
+        return QByteArray();
+    }
+
+    int size = src[1] | (src[2] << 8) | (src[3] << 16);
+    QByteArray out(size, 0);
+    uchar *dest = reinterpret_cast<uchar*>(out.data());
+    int src_pos = 4;
+    int dest_pos = 0;
+
+    while (dest_pos < size) {
+        if (src_pos >= src_size) {
+            qDebug() << "LZ77 data ended unexpectedly";
+            return QByteArray();
+        }
+        uchar flags = src[src_pos++];
+        for (int i = 0; i < 8 && dest_pos < size; i++) {
+            if (flags & (0x80 >> i)) {
+                // Back-reference: 4 bits of length and 12 bits of displacement.
+                if (src_pos + 1 >= src_size) {
+                    qDebug() << "LZ77 data ended unexpectedly";
+                    return QByteArray();
+                }
+                int length = (src[src_pos] >> 4) + 3;
+                int displacement = (((src[src_pos] & 0xf) << 8) | src[src_pos + 1]) + 1;
+                src_pos += 2;
+                if (displacement > dest_pos) {
+                    qDebug() << "LZ77 back-reference is out of range";
+                    return QByteArray();
+                }
+                // The copy may overlap its own output, so it has to go byte by byte.
+                for (int j = 0; j < length && dest_pos < size; j++) {
+                    dest[dest_pos] = dest[dest_pos - displacement];
+                    dest_pos++;
+                }
+            } else {
+                if (src_pos >= src_size) {
+                    qDebug() << "LZ77 data ended unexpectedly";
+                    return QByteArray();
+                }
+                dest[dest_pos++] = src[src_pos++];
+            }
+        }
+    }
+
+    return out;
+}
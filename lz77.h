@@ -0,0 +1,13 @@
+#ifndef LZ77_H
+#define LZ77_H
+
+#include <QByteArray>
+
+// Decompressor for the GBA BIOS LZ77 format (type 0x10) used by .lz graphics.
+class LZ77
+{
+public:
+    static QByteArray decompress(QByteArray data);
+};
+
+#endif // LZ77_H
@@ -1,12 +1,80 @@
 #include "mainwindow.h"
+#include "batch.h"
+#include "tracing.h"
 #include <QApplication>
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
-    a.setStyle("fusion");
-    MainWindow w;
-    w.show();
+    QCoreApplication::setOrganizationName("pret");
+    QCoreApplication::setApplicationName("pretmap");
 
-    return a.exec();
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Map editor for pokeruby. Runs without a window if any batch option is given.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("project", "Project directory (batch mode)");
+    QCommandLineOption renderOption("render", "Render every map to <dir>/<map name>.png.", "dir");
+    QCommandLineOption validateOption("validate", "Check every map's events and connections.");
+    QCommandLineOption resaveOption("resave", "Regenerate every map's files.");
+    QCommandLineOption atlasOption("atlas", "Export a tiled world atlas of connected maps to <dir>.", "dir");
+    QCommandLineOption atlasStartOption("atlas-start", "Map to lay out the world atlas from (default: the largest group of connected maps).", "map");
+    QCommandLineOption threadsOption("threads", "Number of maps to process at once (default: all cores).", "n");
+    QCommandLineOption memoryOption("memory", "Print how much memory the loaded project uses, and where.");
+    QCommandLineOption traceOption("trace", "Record a Chrome trace of loading, rendering and saving to <file> on exit.", "file");
+    parser.addOption(renderOption);
+    parser.addOption(validateOption);
+    parser.addOption(resaveOption);
+    parser.addOption(atlasOption);
+    parser.addOption(atlasStartOption);
+    parser.addOption(threadsOption);
+    parser.addOption(memoryOption);
+    parser.addOption(traceOption);
+
+    QStringList arguments;
+    for (int i = 0; i < argc; i++) {
+        arguments.append(QString::fromLocal8Bit(argv[i]));
+    }
+    parser.parse(arguments);
+
+    // Set up before any window or batch work, so project loading is traced too.
+    QString trace_path = parser.value(traceOption);
+    if (!trace_path.isEmpty()) {
+        Tracing::setEnabled(true);
+    }
+
+    int result;
+    if (parser.isSet(renderOption) || parser.isSet(validateOption) || parser.isSet(resaveOption) || parser.isSet(atlasOption) || parser.isSet(memoryOption)) {
+        // Tilesets and renders still need QImage and QPainter, but no display.
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+        QGuiApplication a(argc, argv);
+        parser.process(a);
+        if (parser.positionalArguments().length() != 1) {
+            parser.showHelp(2);
+        }
+        if (parser.isSet(threadsOption)) {
+            QThreadPool::globalInstance()->setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+        }
+
+        Batch batch(parser.positionalArguments().value(0));
+        batch.render_dir = parser.value(renderOption);
+        batch.validate = parser.isSet(validateOption);
+        batch.resave = parser.isSet(resaveOption);
+        batch.atlas_dir = parser.value(atlasOption);
+        batch.atlas_start = parser.value(atlasStartOption);
+        batch.memory = parser.isSet(memoryOption);
+        result = batch.run();
+    } else {
+        QApplication a(argc, argv);
+        a.setStyle("fusion");
+        MainWindow w;
+        w.show();
+        result = a.exec();
+    }
+
+    if (!trace_path.isEmpty()) {
+        Tracing::save(trace_path);
+    }
+    return result;
 }
@@ -2,11 +2,16 @@
 #include "ui_mainwindow.h"
 #include "project.h"
 #include "editor.h"
+#include "projectwatcher.h"
+#include "worldatlas.h"
+#include "worldview.h"
+#include "tracing.h"
 #include "objectpropertiesframe.h"
 #include "ui_objectpropertiesframe.h"
 
 #include <QDebug>
 #include <QFileDialog>
+#include <QFile>
 #include <QStandardItemModel>
 #include <QShortcut>
 #include <QSettings>
@@ -17,6 +22,13 @@
 #include <QScrollBar>
 #include <QMessageBox>
 #include <QDialogButtonBox>
+#include <QApplication>
+#include <QTimer>
+#include <QtMath>
+#include <QFutureWatcher>
+#include <QPlainTextEdit>
+#include <QFontDatabase>
+#include <QtConcurrent/QtConcurrentRun>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -42,6 +54,33 @@ MainWindow::MainWindow(QWidget *parent) :
 
     on_toolButton_Paint_clicked();
 
+    performanceOverlay = new PerformanceOverlay(editor, ui->graphicsView_Map);
+    performanceOverlay->hide();
+
+    mapPrefetcher = new MapPrefetcher(editor, this);
+
+    hoverStatusTimer = new QTimer(this);
+    hoverStatusTimer->setSingleShot(true);
+    connect(hoverStatusTimer, &QTimer::timeout, [this]() {
+        statusBar()->showMessage(hoverStatusMessage);
+    });
+
+    QActionGroup *mapFormatActions = new QActionGroup(this);
+    mapFormatActions->addAction(ui->action_Map_Format_Asm);
+    mapFormatActions->addAction(ui->action_Map_Format_JSON);
+    mapFormatActions->addAction(ui->action_Map_Format_Binary);
+    ui->action_Map_Format_Asm->setChecked(true);
+    ui->action_Record_Trace->setChecked(Tracing::isEnabled());
+
+    // Journal unsaved edits regularly, but never in the middle of a paint stroke.
+    journalTimer = new QTimer(this);
+    connect(journalTimer, &QTimer::timeout, [this]() {
+        if (editor && editor->project && QApplication::mouseButtons() == Qt::NoButton) {
+            editor->project->journalChanges();
+        }
+    });
+    journalTimer->start(1000);
+
     QSettings settings;
     QString key = "recent_projects";
     if (settings.contains(key)) {
@@ -55,14 +94,31 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    mapPrefetcher->stop();
+    if (editor && editor->project) {
+        editor->project->cancelPrefetches();
+        editor->project->stopJournal();
+        editor->project->saveCache();
+    }
     delete ui;
 }
 
 void MainWindow::setStatusBarMessage(QString message, int timeout/* = 0*/) {
+    // A hover message still waiting to be shown would replace this one.
+    hoverStatusTimer->stop();
     statusBar()->showMessage(message, timeout);
 }
 
+// Hovering can change the message many times a frame. Only the latest one is shown, once per frame.
+void MainWindow::setHoverStatusMessage(QString message) {
+    hoverStatusMessage = message;
+    if (!hoverStatusTimer->isActive()) {
+        hoverStatusTimer->start(Editor::frameInterval());
+    }
+}
+
 void MainWindow::openProject(QString dir) {
+    TRACE_ZONE("MainWindow::openProject", "ui");
     if (dir.isNull()) {
         return;
     }
@@ -75,21 +131,137 @@ void MainWindow::openProject(QString dir) {
         && (editor->project->root == dir)
     );
     if (!already_open) {
+        if (editor->project) {
+            // Nothing of the old project may keep running in the background.
+            mapPrefetcher->stop();
+            editor->project->cancelPrefetches();
+            editor->project->stopJournal();
+            editor->project->saveCache();
+        }
         editor->project = new Project;
         editor->project->root = dir;
+        if (SaveTransaction::recover(dir)) {
+            QMessageBox::warning(this, "Unfinished save", "The last save of this project didn't finish, so it was undone.\nThe edits it was saving can still be recovered if they were journaled.");
+        }
+        editor->project->loadCache();
+        setMapFormat(getProjectMapFormat());
+        editor->project->watcher = new ProjectWatcher(editor->project, this);
+        connect(editor->project->watcher, SIGNAL(mapsChanged(QStringList)), this, SLOT(onMapsChangedOnDisk(QStringList)));
+        connect(editor->project->watcher, SIGNAL(tilesetsChanged(QStringList)), this, SLOT(onTilesetsChangedOnDisk(QStringList)));
         setWindowTitle(editor->project->getProjectTitle() + " - pretmap");
         loadDataStructures();
         populateMapList();
+        recoverJournal();
+        editor->project->startJournal();
         setMap(getDefaultMap());
+        updateMapList();
     } else {
         setWindowTitle(editor->project->getProjectTitle() + " - pretmap");
         loadDataStructures();
         populateMapList();
     }
 
+    editor->project->saveCache();
     setStatusBarMessage(QString("Opened project %1").arg(dir));
 }
 
+// Offers to restore the edits that weren't saved the last time the project was open.
+void MainWindow::recoverJournal() {
+    QString path = Journal::pathForProject(editor->project->root);
+    QList<Journal::Record> records = Journal::read(path);
+    if (records.isEmpty()) {
+        return;
+    }
+
+    QMessageBox::StandardButton answer = QMessageBox::question(
+        this,
+        "Recover unsaved edits",
+        "Some edits to this project were not saved the last time it was open.\nDo you want to restore them?",
+        QMessageBox::Yes | QMessageBox::No,
+        QMessageBox::Yes);
+    if (answer == QMessageBox::Yes) {
+        QStringList map_names = editor->project->replayJournal(records);
+        setStatusBarMessage(QString("Restored unsaved edits to %1 map(s)").arg(map_names.length()));
+    } else {
+        QFile::remove(path);
+    }
+}
+
+void MainWindow::onMapsChangedOnDisk(QStringList map_names) {
+    bool reloaded_current = false;
+    int num_reloaded = 0;
+    for (QString map_name : map_names) {
+        Map *map = editor->project->map_cache->value(map_name);
+        if (!map) {
+            continue;
+        }
+        if (map->hasUnsavedChanges()) {
+            QMessageBox::StandardButton answer = QMessageBox::question(
+                this,
+                "Map changed on disk",
+                QString("%1 was changed outside of pretmap, but it has unsaved edits.\n"
+                        "Reload it and discard your edits?").arg(map_name),
+                QMessageBox::Yes | QMessageBox::No,
+                QMessageBox::No);
+            if (answer != QMessageBox::Yes) {
+                continue;
+            }
+        }
+        editor->project->reloadMap(map);
+        num_reloaded++;
+        if (map == editor->map || (editor->map && map->layout && map->layout == editor->map->layout)) {
+            reloaded_current = true;
+        }
+    }
+
+    if (reloaded_current) {
+        editor->invalidateMapScene();
+        redrawMapScene();
+        displayMapProperties();
+    }
+    if (num_reloaded) {
+        updateMapList();
+        setStatusBarMessage(QString("Reloaded %1 map(s) changed on disk").arg(num_reloaded), 5000);
+    }
+}
+
+void MainWindow::onTilesetsChangedOnDisk(QStringList tileset_labels) {
+    // Tilesets are slow to decode, so they're reread in the background and swapped in once they're ready.
+    Project *project = editor->project;
+    QFutureWatcher<QMap<QString, Tileset*>> *futureWatcher = new QFutureWatcher<QMap<QString, Tileset*>>(this);
+    connect(futureWatcher, &QFutureWatcher<QMap<QString, Tileset*>>::finished, [=]() {
+        futureWatcher->deleteLater();
+        if (project != editor->project) {
+            return;
+        }
+        // World maps and prefetched maps render from the tilesets in the background,
+        // so they have to stop before the old tilesets are deleted.
+        mapPrefetcher->stop();
+        QList<WorldView*> views = findChildren<WorldView*>();
+        for (WorldView *view : views) {
+            view->stopRendering();
+        }
+        QMap<Tileset*, Tileset*> replaced = project->replaceTilesets(futureWatcher->result());
+        for (WorldView *view : views) {
+            view->replaceTilesets(replaced);
+        }
+        if (editor->map && editor->map->layout
+         && (tileset_labels.contains(editor->map->layout->tileset_primary_label)
+          || tileset_labels.contains(editor->map->layout->tileset_secondary_label))) {
+            redrawMapScene();
+        }
+        mapPrefetcher->schedule();
+        setStatusBarMessage(QString("Reloaded %1 tileset(s) changed on disk").arg(tileset_labels.length()), 5000);
+    });
+    futureWatcher->setFuture(QtConcurrent::run([project, tileset_labels]() {
+        QMap<QString, Tileset*> tilesets;
+        for (QString label : tileset_labels) {
+            tilesets.insert(label, project->readTileset(label));
+        }
+        return tilesets;
+    }));
+}
+
 QString MainWindow::getDefaultMap() {
     if (editor && editor->project) {
         QList<QStringList> names = editor->project->groupedMapNames;
@@ -146,6 +318,7 @@ void MainWindow::on_action_Open_Project_triggered()
 }
 
 void MainWindow::setMap(QString map_name) {
+    TRACE_ZONE("MainWindow::setMap", "ui");
     qDebug() << QString("setMap(%1)").arg(map_name);
     if (map_name.isNull()) {
         return;
@@ -158,10 +331,13 @@ void MainWindow::setMap(QString map_name) {
 
     connect(editor->map, SIGNAL(mapChanged(Map*)), this, SLOT(onMapChanged(Map *)));
     connect(editor->map, SIGNAL(mapNeedsRedrawing(Map*)), this, SLOT(onMapNeedsRedrawing(Map *)));
-    connect(editor->map, SIGNAL(statusBarMessage(QString)), this, SLOT(setStatusBarMessage(QString)));
+    connect(editor->map, SIGNAL(statusBarMessage(QString)), this, SLOT(setHoverStatusMessage(QString)), Qt::UniqueConnection);
 
     setRecentMap(map_name);
     updateMapList();
+
+    editor->project->prefetchMapLayouts(editor->project->getAdjacentMapNames(map_name));
+    mapPrefetcher->schedule();
 }
 
 void MainWindow::redrawMapScene()
@@ -171,16 +347,14 @@ void MainWindow::redrawMapScene()
 
     ui->graphicsView_Map->setScene(editor->scene);
     ui->graphicsView_Map->setSceneRect(editor->scene->sceneRect());
-    ui->graphicsView_Map->setFixedSize(editor->scene->width() + 2, editor->scene->height() + 2);
 
     ui->graphicsView_Objects_Map->setScene(editor->scene);
     ui->graphicsView_Objects_Map->setSceneRect(editor->scene->sceneRect());
-    ui->graphicsView_Objects_Map->setFixedSize(editor->scene->width() + 2, editor->scene->height() + 2);
     ui->graphicsView_Objects_Map->editor = editor;
 
     ui->graphicsView_Connections->setScene(editor->scene);
     ui->graphicsView_Connections->setSceneRect(editor->scene->sceneRect());
-    ui->graphicsView_Connections->setFixedSize(editor->scene->width() + 2, editor->scene->height() + 2);
+    applyMapZoom();
 
     ui->graphicsView_Metatiles->setScene(editor->scene_metatiles);
     //ui->graphicsView_Metatiles->setSceneRect(editor->scene_metatiles->sceneRect());
@@ -197,6 +371,38 @@ void MainWindow::redrawMapScene()
     ui->graphicsView_Collision->setFixedSize(editor->collision_metatiles_item->pixmap().width() + 2, editor->collision_metatiles_item->pixmap().height() + 2);
 }
 
+// Scales the map, events and connections views, which all show the map scene.
+void MainWindow::applyMapZoom() {
+    if (!editor->scene) {
+        return;
+    }
+    QTransform transform = QTransform::fromScale(map_zoom, map_zoom);
+    int width = qCeil(editor->scene->width() * map_zoom) + 2;
+    int height = qCeil(editor->scene->height() * map_zoom) + 2;
+    for (QGraphicsView *view : QList<QGraphicsView*>() << ui->graphicsView_Map << ui->graphicsView_Objects_Map << ui->graphicsView_Connections) {
+        view->setTransform(transform);
+        view->setFixedSize(width, height);
+    }
+}
+
+void MainWindow::on_action_Zoom_In_triggered()
+{
+    map_zoom = qMin(map_zoom * 2, 8.0);
+    applyMapZoom();
+}
+
+void MainWindow::on_action_Zoom_Out_triggered()
+{
+    map_zoom = qMax(map_zoom / 2, 0.125);
+    applyMapZoom();
+}
+
+void MainWindow::on_action_Actual_Size_triggered()
+{
+    map_zoom = 1.0;
+    applyMapZoom();
+}
+
 void MainWindow::openWarpMap(QString map_name, QString warp_num) {
     // Ensure valid destination map name.
     if (!editor->project->mapNames->contains(map_name)) {
@@ -241,6 +447,39 @@ void MainWindow::setRecentMap(QString map_name) {
     settings.setValue(key, qmap);
 }
 
+MapFormat::Format MainWindow::getProjectMapFormat() {
+    QString root = editor->project->root;
+    if (MapFormat::hasProjectFormat(root)) {
+        return MapFormat::projectFormat(root);
+    }
+    // Older versions kept the format in the user's settings. Move it into the project.
+    QSettings settings;
+    QString key = "project:" + root;
+    QMap<QString, QVariant> qmap = settings.value(key).toMap();
+    if (!qmap.contains("map_format")) {
+        return MapFormat::Asm;
+    }
+    MapFormat::Format format = MapFormat::fromName(qmap.take("map_format").toString());
+    MapFormat::setProjectFormat(root, format);
+    settings.setValue(key, qmap);
+    return format;
+}
+
+// Chooses which format maps are read from. Maps that are already open aren't reread.
+void MainWindow::setMapFormat(MapFormat::Format format) {
+    ui->action_Map_Format_Asm->setChecked(format == MapFormat::Asm);
+    ui->action_Map_Format_JSON->setChecked(format == MapFormat::Json);
+    ui->action_Map_Format_Binary->setChecked(format == MapFormat::Binary);
+    if (!editor->project) {
+        return;
+    }
+    editor->project->map_format = format;
+    // Projects that read asm, the default, don't need a config file.
+    if (MapFormat::projectFormat(editor->project->root) != format) {
+        MapFormat::setProjectFormat(editor->project->root, format);
+    }
+}
+
 void MainWindow::displayMapProperties() {
     ui->comboBox_Song->clear();
     ui->comboBox_Location->clear();
@@ -290,6 +529,7 @@ void MainWindow::on_comboBox_Song_activated(const QString &song)
 {
     if (editor && editor->map) {
         editor->map->song = song;
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -297,6 +537,7 @@ void MainWindow::on_comboBox_Location_activated(const QString &location)
 {
     if (editor && editor->map) {
         editor->map->location = location;
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -304,6 +545,7 @@ void MainWindow::on_comboBox_Visibility_activated(const QString &requiresFlash)
 {
     if (editor && editor->map) {
         editor->map->requiresFlash = requiresFlash;
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -311,6 +553,7 @@ void MainWindow::on_comboBox_Weather_activated(const QString &weather)
 {
     if (editor && editor->map) {
         editor->map->weather = weather;
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -318,6 +561,7 @@ void MainWindow::on_comboBox_Type_activated(const QString &type)
 {
     if (editor && editor->map) {
         editor->map->type = type;
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -325,6 +569,7 @@ void MainWindow::on_comboBox_BattleScene_activated(const QString &battle_scene)
 {
     if (editor && editor->map) {
         editor->map->battle_scene = battle_scene;
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -336,6 +581,7 @@ void MainWindow::on_checkBox_Visibility_clicked(bool checked)
         } else {
             editor->map->requiresFlash = "FALSE";
         }
+        editor->map->has_unsaved_changes = true;
     }
 }
 
@@ -347,28 +593,16 @@ void MainWindow::on_checkBox_ShowLocation_clicked(bool checked)
         } else {
             editor->map->show_location = "FALSE";
         }
+        editor->map->has_unsaved_changes = true;
     }
 }
 
 void MainWindow::loadDataStructures() {
-    Project *project = editor->project;
-    project->readMapLayoutsTable();
-    project->readAllMapLayouts();
-    project->readRegionMapSections();
-    project->readItemNames();
-    project->readFlagNames();
-    project->readVarNames();
-    project->readMovementTypes();
-    project->readMapTypes();
-    project->readMapBattleScenes();
-    project->readWeatherNames();
-    project->readCoordEventWeatherNames();
-    project->readSecretBaseIds();
-    project->readBgEventFacingDirections();
-    project->readMapsWithConnections();
+    editor->project->readDataStructures();
 }
 
 void MainWindow::populateMapList() {
+    TRACE_ZONE("MainWindow::populateMapList", "ui");
     Project *project = editor->project;
 
     QIcon mapFolderIcon;
@@ -470,8 +704,10 @@ void MainWindow::onAddNewMapToGroupClick(QAction* triggeredAction)
 
     QString newMapName = editor->project->getNewMapName();
     Map* newMap = editor->project->addNewMapToGroup(newMapName, groupNum);
+    editor->project->beginSave();
     editor->project->saveMap(newMap);
     editor->project->saveAllDataStructures();
+    reportSaveResult(editor->project->commitSave(saveProgress()));
 
     int numMapsInGroup = groupItem->rowCount();
     QStandardItem *newMapItem = createMapItem(newMapName, groupNum, numMapsInGroup);
@@ -537,10 +773,28 @@ void MainWindow::updateMapList() {
 
 void MainWindow::on_action_Save_Project_triggered()
 {
-    editor->saveProject();
+    reportSaveResult(editor->saveProject(saveProgress()));
     updateMapList();
 }
 
+std::function<void(int, int)> MainWindow::saveProgress() {
+    // Only the status bar is repainted. Processing events here would let timers (the journal,
+    // the project watcher) run in the middle of the save.
+    return [this](int done, int total) {
+        setStatusBarMessage(QString("Saving... (%1/%2 files)").arg(done).arg(total));
+        statusBar()->repaint();
+    };
+}
+
+void MainWindow::reportSaveResult(bool success) {
+    if (success) {
+        setStatusBarMessage("Saved", 2000);
+    } else {
+        setStatusBarMessage("Save failed");
+        QMessageBox::critical(this, "Save failed", "The project could not be saved. No files were changed.");
+    }
+}
+
 void MainWindow::undo() {
     editor->undo();
 }
@@ -550,7 +804,7 @@ void MainWindow::redo() {
 }
 
 void MainWindow::on_action_Save_triggered() {
-    editor->save();
+    reportSaveResult(editor->save(saveProgress()));
     updateMapList();
 }
 
@@ -589,6 +843,31 @@ void MainWindow::on_actionRedo_triggered()
     redo();
 }
 
+void MainWindow::on_action_Cut_triggered()
+{
+    editor->cutSelection();
+}
+
+void MainWindow::on_action_Copy_triggered()
+{
+    editor->copySelection();
+}
+
+void MainWindow::on_action_Paste_triggered()
+{
+    editor->pasteBlocks();
+}
+
+void MainWindow::on_action_Fill_Selection_triggered()
+{
+    editor->fillSelection();
+}
+
+void MainWindow::on_action_Select_All_triggered()
+{
+    editor->selectAllBlocks();
+}
+
 void MainWindow::addNewEvent(QString event_type)
 {
     if (editor) {
@@ -927,6 +1206,163 @@ void MainWindow::on_action_Export_Map_Image_triggered()
     }
 }
 
+void MainWindow::on_action_Export_World_Atlas_triggered()
+{
+    if (!editor->project || !editor->map) {
+        return;
+    }
+    QString dir = QFileDialog::getExistingDirectory(this, "Export World Atlas", editor->project->root);
+    if (dir.isEmpty()) {
+        return;
+    }
+
+    setStatusBarMessage("Laying out the world...");
+    WorldAtlas atlas(editor->project);
+    atlas.build(editor->map->name);
+    bool success = atlas.exportTiles(dir, [this](int done, int total) {
+        setStatusBarMessage(QString("Exporting world atlas... (%1/%2 levels)").arg(done).arg(total));
+        QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+    });
+    if (success) {
+        setStatusBarMessage(QString("Exported %1 maps to %2").arg(atlas.placements.length()).arg(dir), 5000);
+    } else {
+        setStatusBarMessage("World atlas export failed");
+        QMessageBox::critical(this, "Export failed", QString("The world atlas could not be written to %1.").arg(dir));
+    }
+    updateMapList();
+}
+
+void MainWindow::on_action_Show_World_Map_triggered()
+{
+    if (!editor->project || !editor->map) {
+        return;
+    }
+    WorldAtlas *atlas = new WorldAtlas(editor->project);
+    atlas->build(editor->map->name);
+    WorldView *view = new WorldView(atlas, this);
+    view->show();
+    updateMapList();
+}
+
+void MainWindow::exportMaps(MapFormat::Format format) {
+    if (!editor->project) {
+        return;
+    }
+    reportSaveResult(editor->project->exportMaps(format, saveProgress()));
+    updateMapList();
+}
+
+void MainWindow::importMaps(MapFormat::Format format) {
+    if (!editor->project) {
+        return;
+    }
+    QMessageBox::StandardButton answer = QMessageBox::question(
+        this,
+        "Import maps",
+        QString("Regenerate the asm of every map that has a %1 document?\n"
+                "Unsaved edits to those maps will be lost.").arg(MapFormat::name(format)),
+        QMessageBox::Yes | QMessageBox::No,
+        QMessageBox::No);
+    if (answer != QMessageBox::Yes) {
+        return;
+    }
+    reportSaveResult(editor->project->importMaps(format, saveProgress()));
+    if (editor->map) {
+        editor->invalidateMapScene();
+        redrawMapScene();
+        displayMapProperties();
+    }
+    updateMapList();
+}
+
+void MainWindow::on_action_Export_Maps_JSON_triggered()
+{
+    exportMaps(MapFormat::Json);
+}
+
+void MainWindow::on_action_Export_Maps_Binary_triggered()
+{
+    exportMaps(MapFormat::Binary);
+}
+
+void MainWindow::on_action_Import_Maps_JSON_triggered()
+{
+    importMaps(MapFormat::Json);
+}
+
+void MainWindow::on_action_Import_Maps_Binary_triggered()
+{
+    importMaps(MapFormat::Binary);
+}
+
+void MainWindow::on_action_Map_Format_Asm_triggered()
+{
+    setMapFormat(MapFormat::Asm);
+}
+
+void MainWindow::on_action_Map_Format_JSON_triggered()
+{
+    setMapFormat(MapFormat::Json);
+}
+
+void MainWindow::on_action_Map_Format_Binary_triggered()
+{
+    setMapFormat(MapFormat::Binary);
+}
+
+void MainWindow::on_action_Performance_Overlay_triggered(bool checked)
+{
+    performanceOverlay->setVisible(checked);
+    performanceOverlay->raise();
+}
+
+void MainWindow::on_action_Record_Trace_triggered(bool checked)
+{
+    if (checked) {
+        Tracing::clear();
+        Tracing::setEnabled(true);
+        setStatusBarMessage("Recording trace");
+    } else {
+        Tracing::setEnabled(false);
+        setStatusBarMessage(QString("Recorded %1 trace events").arg(Tracing::eventCount()), 5000);
+    }
+}
+
+void MainWindow::on_action_Save_Trace_triggered()
+{
+    QString dir = editor->project ? editor->project->root : QString();
+    QString defaultFilepath = QString("%1/pretmap-trace.json").arg(dir);
+    QString filepath = QFileDialog::getSaveFileName(this, "Save Trace", defaultFilepath, "Chrome Trace (*.json)");
+    if (filepath.isEmpty()) {
+        return;
+    }
+    if (Tracing::save(filepath)) {
+        setStatusBarMessage(QString("Saved %1 trace events to %2").arg(Tracing::eventCount()).arg(filepath), 5000);
+    } else {
+        QMessageBox::warning(this, "Save Trace", QString("Could not write '%1'.").arg(filepath));
+    }
+}
+
+void MainWindow::on_action_Memory_Usage_triggered()
+{
+    if (!editor->project) {
+        return;
+    }
+    QDialog dialog(this);
+    dialog.setWindowTitle("Memory Usage");
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QPlainTextEdit *text = new QPlainTextEdit(&dialog);
+    text->setReadOnly(true);
+    text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    text->setPlainText(editor->project->memoryReport().join("\n"));
+    layout->addWidget(text);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+    layout->addWidget(buttons);
+    dialog.resize(480, 480);
+    dialog.exec();
+}
+
 void MainWindow::on_comboBox_ConnectionDirection_currentIndexChanged(const QString &direction)
 {
     editor->updateCurrentConnectionDirection(direction);
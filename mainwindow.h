@@ -9,9 +9,12 @@
 #include <QGraphicsItemGroup>
 #include <QGraphicsSceneMouseEvent>
 #include <QAbstractItemModel>
+#include <QTimer>
 #include "project.h"
 #include "map.h"
 #include "editor.h"
+#include "perfoverlay.h"
+#include "mapprefetcher.h"
 
 namespace Ui {
 class MainWindow;
@@ -27,6 +30,9 @@ public:
 
 public slots:
     void setStatusBarMessage(QString message, int timeout = 0);
+    void setHoverStatusMessage(QString message);
+    void onMapsChangedOnDisk(QStringList map_names);
+    void onTilesetsChangedOnDisk(QStringList tileset_labels);
 
 private slots:
     void on_action_Open_Project_triggered();
@@ -58,6 +64,12 @@ private slots:
 
     void on_actionRedo_triggered();
 
+    void on_action_Cut_triggered();
+    void on_action_Copy_triggered();
+    void on_action_Paste_triggered();
+    void on_action_Fill_Selection_triggered();
+    void on_action_Select_All_triggered();
+
     void on_toolButton_deleteObject_clicked();
 
     void addNewEvent(QString);
@@ -77,6 +89,22 @@ private slots:
     void currentMetatilesSelectionChanged();
 
     void on_action_Export_Map_Image_triggered();
+    void on_action_Export_World_Atlas_triggered();
+    void on_action_Zoom_In_triggered();
+    void on_action_Zoom_Out_triggered();
+    void on_action_Actual_Size_triggered();
+    void on_action_Performance_Overlay_triggered(bool checked);
+    void on_action_Show_World_Map_triggered();
+    void on_action_Export_Maps_JSON_triggered();
+    void on_action_Export_Maps_Binary_triggered();
+    void on_action_Import_Maps_JSON_triggered();
+    void on_action_Import_Maps_Binary_triggered();
+    void on_action_Map_Format_Asm_triggered();
+    void on_action_Map_Format_JSON_triggered();
+    void on_action_Map_Format_Binary_triggered();
+    void on_action_Record_Trace_triggered(bool checked);
+    void on_action_Save_Trace_triggered();
+    void on_action_Memory_Usage_triggered();
 
     void on_comboBox_ConnectionDirection_currentIndexChanged(const QString &arg1);
 
@@ -108,19 +136,33 @@ private:
     QList<QStandardItem*> *mapGroupsModel;
     Editor *editor = NULL;
     QIcon* mapIcon;
+    QTimer *journalTimer = NULL;
+    PerformanceOverlay *performanceOverlay = NULL;
+    MapPrefetcher *mapPrefetcher = NULL;
+    QTimer *hoverStatusTimer = NULL;
+    QString hoverStatusMessage;
+    qreal map_zoom = 1.0;
+    void applyMapZoom();
     void setMap(QString);
     void redrawMapScene();
     void loadDataStructures();
     void populateMapList();
     QString getExistingDirectory(QString);
     void openProject(QString dir);
+    void recoverJournal();
     QString getDefaultMap();
     void setRecentMap(QString map_name);
+    MapFormat::Format getProjectMapFormat();
+    void setMapFormat(MapFormat::Format format);
+    void exportMaps(MapFormat::Format format);
+    void importMaps(MapFormat::Format format);
     QStandardItem* createMapItem(QString mapName, int groupNum, int inGroupNum);
 
     void markAllEdited(QAbstractItemModel *model);
     void markEdited(QModelIndex index);
     void updateMapList();
+    std::function<void(int, int)> saveProgress();
+    void reportSaveResult(bool success);
 
     void displayMapProperties();
     void checkToolButtons();
@@ -1,4 +1,5 @@
 #include "map.h"
+#include "tracing.h"
 
 #include <QTime>
 #include <QDebug>
@@ -18,6 +19,41 @@ Map::Map(QObject *parent) : QObject(parent)
     selected_metatiles->append(1);
 }
 
+MemoryUsage MapLayout::memoryUsage() {
+    MemoryUsage usage;
+    usage.add("blockdata", MemoryUsage::blockdataBytes(blockdata));
+    usage.add("border", MemoryUsage::blockdataBytes(border));
+    usage.add("blockdata copies", MemoryUsage::blockdataBytes(cached_blockdata)
+              + MemoryUsage::blockdataBytes(cached_collision)
+              + MemoryUsage::blockdataBytes(cached_border));
+    usage.add("border image", MemoryUsage::imageBytes(border_image) + MemoryUsage::pixmapBytes(border_pixmap));
+    return usage;
+}
+
+MemoryUsage Map::memoryUsage() {
+    MemoryUsage usage;
+    usage.add("map image", MemoryUsage::imageBytes(image));
+    usage.add("map pixmap", MemoryUsage::pixmapBytes(pixmap));
+    usage.add("collision image", MemoryUsage::imageBytes(collision_image));
+    usage.add("collision pixmap", MemoryUsage::pixmapBytes(collision_pixmap));
+    usage.add("mipmaps", mipmaps.bytes() + collision_mipmaps.bytes());
+    for (QImage metatile_image : metatile_images) {
+        usage.add("metatile images", MemoryUsage::imageBytes(metatile_image));
+    }
+    for (int i = 0; i < history.length(); i++) {
+        usage.add("undo history", sizeof(HistoryItem) + MemoryUsage::blockdataBytes(history.at(i)->metatiles));
+    }
+    // Event pixmaps are shared with the project's sprite cache, so they're counted there.
+    for (Event *event : getAllEvents()) {
+        qint64 bytes = sizeof(Event);
+        for (QString key : event->values.keys()) {
+            bytes += MemoryUsage::stringBytes(key) + MemoryUsage::stringBytes(event->values.value(key));
+        }
+        usage.add("events", bytes);
+    }
+    return usage;
+}
+
 void Map::setName(QString mapName) {
     name = mapName;
     constantName = mapConstantFromName(mapName);
@@ -87,8 +123,8 @@ QImage Map::getCollisionMetatileImage(Block block) {
 QImage Map::getCollisionMetatileImage(int collision, int elevation) {
     int x = collision * 16;
     int y = elevation * 16;
-    QPixmap collisionImage = QPixmap(":/images/collisions.png").copy(x, y, 16, 16);
-    return collisionImage.toImage();
+    // QImage rather than QPixmap, so collision can be drawn off the main thread.
+    return QImage(":/images/collisions.png").copy(x, y, 16, 16);
 }
 
 bool Map::blockChanged(int i, Blockdata *cache) {
@@ -127,6 +163,7 @@ void Map::cacheBorder() {
 void Map::cacheBlockdata() {
     if (layout->cached_blockdata) delete layout->cached_blockdata;
     layout->cached_blockdata = new Blockdata;
+    layout->cached_blockdata_map = this;
     if (layout->blockdata && layout->blockdata->blocks) {
         for (int i = 0; i < layout->blockdata->blocks->length(); i++) {
             Block block = layout->blockdata->blocks->value(i);
@@ -138,6 +175,7 @@ void Map::cacheBlockdata() {
 void Map::cacheCollision() {
     if (layout->cached_collision) delete layout->cached_collision;
     layout->cached_collision = new Blockdata;
+    layout->cached_collision_map = this;
     if (layout->blockdata && layout->blockdata->blocks) {
         for (int i = 0; i < layout->blockdata->blocks->length(); i++) {
             Block block = layout->blockdata->blocks->value(i);
@@ -147,6 +185,10 @@ void Map::cacheCollision() {
 }
 
 QPixmap Map::renderCollision(bool ignoreCache) {
+    TRACE_ZONE("Map::renderCollision", "render");
+    if (!hasCurrentCollisionRender()) {
+        ignoreCache = true;
+    }
     bool changed_any = false;
     int width_ = getWidth();
     int height_ = getHeight();
@@ -160,14 +202,17 @@ QPixmap Map::renderCollision(bool ignoreCache) {
     }
     if (!(layout->blockdata && layout->blockdata->blocks && width_ && height_)) {
         collision_pixmap = collision_pixmap.fromImage(collision_image);
+        collision_mipmaps.clear();
         return collision_pixmap;
     }
+    QRect dirty = changed_any ? collision_image.rect() : QRect();
     QPainter painter(&collision_image);
     for (int i = 0; i < layout->blockdata->blocks->length(); i++) {
         if (!ignoreCache && layout->cached_collision && !blockChanged(i, layout->cached_collision)) {
             continue;
         }
         changed_any = true;
+        dirty |= QRect((i % width_) * 16, (i / width_) * 16, 16, 16);
         Block block = layout->blockdata->blocks->value(i);
         QImage metatile_image = Metatile::getMetatileImage(block.tile, layout->tileset_primary, layout->tileset_secondary);
         QImage collision_metatile_image = getCollisionMetatileImage(block);
@@ -183,13 +228,19 @@ QPixmap Map::renderCollision(bool ignoreCache) {
     }
     painter.end();
     cacheCollision();
+    collision_image_tilesets = qMakePair(layout->tileset_primary, layout->tileset_secondary);
     if (changed_any) {
         collision_pixmap = collision_pixmap.fromImage(collision_image);
+        collision_mipmaps.update(collision_image, dirty);
     }
     return collision_pixmap;
 }
 
 QPixmap Map::render(bool ignoreCache = false) {
+    TRACE_ZONE("Map::render", "render");
+    if (!hasCurrentRender()) {
+        ignoreCache = true;
+    }
     bool changed_any = false;
     int width_ = getWidth();
     int height_ = getHeight();
@@ -203,15 +254,19 @@ QPixmap Map::render(bool ignoreCache = false) {
     }
     if (!(layout->blockdata && layout->blockdata->blocks && width_ && height_)) {
         pixmap = pixmap.fromImage(image);
+        mipmaps.clear();
         return pixmap;
     }
 
+    // Only the part of the mipmaps under changed blocks is rebuilt.
+    QRect dirty = changed_any ? image.rect() : QRect();
     QPainter painter(&image);
     for (int i = 0; i < layout->blockdata->blocks->length(); i++) {
         if (!ignoreCache && !blockChanged(i, layout->cached_blockdata)) {
             continue;
         }
         changed_any = true;
+        dirty |= QRect((i % width_) * 16, (i / width_) * 16, 16, 16);
         Block block = layout->blockdata->blocks->value(i);
         QImage metatile_image = Metatile::getMetatileImage(block.tile, layout->tileset_primary, layout->tileset_secondary);
         int map_y = width_ ? i / width_ : 0;
@@ -220,15 +275,96 @@ QPixmap Map::render(bool ignoreCache = false) {
         painter.drawImage(metatile_origin, metatile_image);
     }
     painter.end();
+    image_tilesets = qMakePair(layout->tileset_primary, layout->tileset_secondary);
     if (changed_any) {
         cacheBlockdata();
         pixmap = pixmap.fromImage(image);
+        mipmaps.update(image, dirty);
     }
 
     return pixmap;
 }
 
+// Draws blocks like render() or renderCollision(), but without touching any map. This is safe
+// to call from other threads, as long as the tilesets aren't deleted until it returns.
+QImage Map::renderBlocks(QList<Block> blocks, int width, int height, Tileset *primary, Tileset *secondary, bool collision) {
+    TRACE_ZONE("Map::renderBlocks", "render");
+    QImage rendered(width * 16, height * 16, QImage::Format_RGBA8888);
+    if (!width || !height) {
+        return rendered;
+    }
+    QPainter painter(&rendered);
+    for (int i = 0; i < blocks.length(); i++) {
+        Block block = blocks.at(i);
+        QPoint metatile_origin = QPoint((i % width) * 16, (i / width) * 16);
+        painter.setOpacity(1);
+        painter.drawImage(metatile_origin, Metatile::getMetatileImage(block.tile, primary, secondary));
+        if (collision) {
+            painter.setOpacity(0.55);
+            painter.drawImage(metatile_origin, getCollisionMetatileImage(block));
+        }
+    }
+    painter.end();
+    return rendered;
+}
+
+// Takes an image from renderBlocks(), if the map still has the blocks and tilesets it was drawn from.
+bool Map::setRender(QImage rendered, QList<Block> blocks, QPair<Tileset*, Tileset*> tilesets, bool collision) {
+    if (!layout || !layout->blockdata || !layout->blockdata->blocks
+     || tilesets != qMakePair(layout->tileset_primary, layout->tileset_secondary)
+     || rendered.size() != QSize(getWidth() * 16, getHeight() * 16)
+     || layout->blockdata->blocks->length() != blocks.length()) {
+        return false;
+    }
+    for (int i = 0; i < blocks.length(); i++) {
+        if (layout->blockdata->blocks->value(i) != blocks.at(i)) {
+            return false;
+        }
+    }
+    if (collision) {
+        collision_image = rendered;
+        cacheCollision();
+        collision_image_tilesets = tilesets;
+        collision_pixmap = collision_pixmap.fromImage(collision_image);
+        collision_mipmaps.update(collision_image, collision_image.rect());
+    } else {
+        image = rendered;
+        cacheBlockdata();
+        image_tilesets = tilesets;
+        pixmap = pixmap.fromImage(image);
+        mipmaps.update(image, image.rect());
+    }
+    return true;
+}
+
+// Whether image only needs the blocks that changed since it was drawn redrawn.
+// It doesn't if another map with the same layout was drawn since, or the tilesets were replaced.
+bool Map::hasCurrentRender() {
+    return !image.isNull()
+            && image.size() == QSize(getWidth() * 16, getHeight() * 16)
+            && layout->cached_blockdata_map == this
+            && image_tilesets == qMakePair(layout->tileset_primary, layout->tileset_secondary);
+}
+
+bool Map::hasCurrentCollisionRender() {
+    return !collision_image.isNull()
+            && collision_image.size() == QSize(getWidth() * 16, getHeight() * 16)
+            && layout->cached_collision_map == this
+            && collision_image_tilesets == qMakePair(layout->tileset_primary, layout->tileset_secondary);
+}
+
+// Frees the rendered images. They're drawn again in full the next time they're needed.
+void Map::releaseRenders() {
+    image = QImage();
+    pixmap = QPixmap();
+    mipmaps.clear();
+    collision_image = QImage();
+    collision_pixmap = QPixmap();
+    collision_mipmaps.clear();
+}
+
 QPixmap Map::renderBorder() {
+    TRACE_ZONE("Map::renderBorder", "render");
     bool changed_any = false;
     int width_ = 2;
     int height_ = 2;
@@ -261,6 +397,7 @@ QPixmap Map::renderBorder() {
 }
 
 QPixmap Map::renderConnection(Connection connection) {
+    TRACE_ZONE("Map::renderConnection", "render");
     render();
     int x, y, w, h;
     if (connection.direction == "up") {
@@ -296,6 +433,7 @@ QPixmap Map::renderConnection(Connection connection) {
 }
 
 QPixmap Map::renderCollisionMetatiles() {
+    TRACE_ZONE("Map::renderCollisionMetatiles", "render");
     int width_ = 2;
     int height_ = 16;
     QImage image(width_ * 32, height_ * 32, QImage::Format_RGBA8888);
@@ -329,6 +467,7 @@ void Map::drawSelection(int i, int w, int selectionWidth, int selectionHeight, Q
 }
 
 QPixmap Map::renderMetatiles() {
+    TRACE_ZONE("Map::renderMetatiles", "render");
     if (!layout->tileset_primary || !layout->tileset_primary->metatiles
      || !layout->tileset_secondary || !layout->tileset_secondary->metatiles) {
         return QPixmap();
@@ -539,7 +678,18 @@ void Map::redo() {
     }
 }
 
+// Deletes the undo history, e.g. once the map was reread and the blocks it restores are stale.
+void Map::clearHistory() {
+    for (int i = 0; i < history.length(); i++) {
+        HistoryItem *item = history.at(i);
+        delete item->metatiles;
+        delete item;
+    }
+    history.clear();
+}
+
 void Map::commit() {
+    TRACE_ZONE("Map::commit", "edit");
     if (layout->blockdata) {
         HistoryItem *item = history.current();
         bool atCurrentHistory = item
@@ -562,7 +712,76 @@ void Map::setBlock(int x, int y, Block block) {
     }
 }
 
+BlockBuffer Map::copyBlocks(QRect rect) {
+    rect &= QRect(0, 0, getWidth(), getHeight());
+    if (rect.isEmpty() || !(layout->blockdata && layout->blockdata->blocks)) {
+        return BlockBuffer();
+    }
+    BlockBuffer buffer(rect.width(), rect.height());
+    buffer.tileset_primary_label = layout->tileset_primary_label;
+    buffer.tileset_secondary_label = layout->tileset_secondary_label;
+    QList<Block> *blocks = layout->blockdata->blocks;
+    for (int y = 0; y < rect.height(); y++)
+    for (int x = 0; x < rect.width(); x++) {
+        buffer.set(x, y, blocks->at((rect.y() + y) * getWidth() + rect.x() + x));
+    }
+    return buffer;
+}
+
+void Map::pasteBlocks(QPoint pos, BlockBuffer *buffer) {
+    TRACE_ZONE("Map::pasteBlocks", "edit");
+    _pasteBlocks(pos, buffer);
+    commit();
+}
+
+void Map::fillBlocks(QRect rect, BlockBuffer *pattern, quint16 mask) {
+    TRACE_ZONE("Map::fillBlocks", "edit");
+    _fillBlocks(rect, pattern, mask);
+    commit();
+}
+
+// Fills rect with fill, then pastes what was in it at pos.
+void Map::moveBlocks(QRect rect, QPoint pos, BlockBuffer *fill, quint16 mask) {
+    TRACE_ZONE("Map::moveBlocks", "edit");
+    BlockBuffer buffer = copyBlocks(rect);
+    if (buffer.isEmpty()) {
+        return;
+    }
+    _fillBlocks(rect, fill, mask);
+    _pasteBlocks(pos + (rect & QRect(0, 0, getWidth(), getHeight())).topLeft() - rect.topLeft(), &buffer);
+    commit();
+}
+
+// Writes buffer with its top-left block at pos. Blocks that fall outside the map are dropped.
+void Map::_pasteBlocks(QPoint pos, BlockBuffer *buffer) {
+    if (!(layout->blockdata && layout->blockdata->blocks)) {
+        return;
+    }
+    QRect rect = QRect(pos, QSize(buffer->width, buffer->height)) & QRect(0, 0, getWidth(), getHeight());
+    QList<Block> *blocks = layout->blockdata->blocks;
+    for (int y = rect.top(); y <= rect.bottom(); y++)
+    for (int x = rect.left(); x <= rect.right(); x++) {
+        blocks->replace(y * getWidth() + x, buffer->at(x - pos.x(), y - pos.y()));
+    }
+}
+
+// Tiles pattern over rect, starting from its top-left corner. Only the bits of each block in mask are written.
+void Map::_fillBlocks(QRect rect, BlockBuffer *pattern, quint16 mask) {
+    if (!(layout->blockdata && layout->blockdata->blocks) || pattern->isEmpty()) {
+        return;
+    }
+    QRect clipped = rect & QRect(0, 0, getWidth(), getHeight());
+    QList<Block> *blocks = layout->blockdata->blocks;
+    for (int y = clipped.top(); y <= clipped.bottom(); y++)
+    for (int x = clipped.left(); x <= clipped.right(); x++) {
+        int i = y * getWidth() + x;
+        quint16 value = pattern->blocks.at(((y - rect.y()) % pattern->height) * pattern->width + (x - rect.x()) % pattern->width);
+        blocks->replace(i, Block((Block(blocks->at(i)).rawValue() & ~mask) | (value & mask)));
+    }
+}
+
 void Map::floodFillCollision(int x, int y, uint collision) {
+    TRACE_ZONE("Map::floodFillCollision", "edit");
     Block *block = getBlock(x, y);
     if (block && block->collision != collision) {
         _floodFillCollision(x, y, collision);
@@ -571,6 +790,7 @@ void Map::floodFillCollision(int x, int y, uint collision) {
 }
 
 void Map::floodFillElevation(int x, int y, uint elevation) {
+    TRACE_ZONE("Map::floodFillElevation", "edit");
     Block *block = getBlock(x, y);
     if (block && block->elevation != elevation) {
         _floodFillElevation(x, y, elevation);
@@ -578,6 +798,7 @@ void Map::floodFillElevation(int x, int y, uint elevation) {
     }
 }
 void Map::floodFillCollisionElevation(int x, int y, uint collision, uint elevation) {
+    TRACE_ZONE("Map::floodFillCollisionElevation", "edit");
     Block *block = getBlock(x, y);
     if (block && (block->collision != collision || block->elevation != elevation)) {
         _floodFillCollisionElevation(x, y, collision, elevation);
@@ -603,8 +824,17 @@ void Map::addEvent(Event *event) {
     events[event->get("event_group_type")].append(event);
 }
 
+QList<quint64> Map::getEventRevisions() {
+    QList<quint64> revisions;
+    for (Event *event : getAllEvents()) {
+        revisions.append(event->revision);
+    }
+    return revisions;
+}
+
 bool Map::hasUnsavedChanges() {
-    return !history.isSaved() || !isPersistedToFile || layout->has_unsaved_changes;
+    return !history.isSaved() || !isPersistedToFile || has_unsaved_changes || layout->has_unsaved_changes
+        || getEventRevisions() != saved_event_revisions;
 }
 
 void Map::hoveredTileChanged(int x, int y, int block) {
@@ -658,5 +888,23 @@ void Map::setSelectedMetatilesFromTilePicker() {
             this->selected_metatiles->append(metatile);
         }
     }
+    this->selected_blocks = BlockBuffer();
+}
+
+void Map::setSelectedBlocks(BlockBuffer blocks) {
+    this->selected_metatiles_width = blocks.width;
+    this->selected_metatiles_height = blocks.height;
+    *this->selected_metatiles = blocks.tiles();
+    this->selected_blocks = blocks;
+}
+
+// Paints the block at index in the selection over block. Blocks picked from the map replace
+// it whole; metatiles from the picker only replace its metatile.
+void Map::paintSelectedBlock(int index, Block *block) {
+    if (index < this->selected_blocks.blocks.size()) {
+        *block = Block(this->selected_blocks.blocks.at(index));
+    } else {
+        block->tile = this->selected_metatiles->at(index);
+    }
 }
 
@@ -3,13 +3,18 @@
 
 #include "tileset.h"
 #include "blockdata.h"
+#include "blockbuffer.h"
 #include "event.h"
+#include "mipmaps.h"
+#include "memoryusage.h"
 
 #include <QPixmap>
 #include <QObject>
 #include <QDebug>
 #include <QGraphicsPixmapItem>
 
+class Map;
+
 class HistoryItem {
 public:
     Blockdata *metatiles;
@@ -30,12 +35,14 @@ public:
     }
     T back() {
         if (head > 0) {
+            revision = ++lastRevision;
             return history.at(--head);
         }
         return NULL;
     }
     T next() {
         if (head + 1 < history.length()) {
+            revision = ++lastRevision;
             return history.at(++head);
         }
         return NULL;
@@ -49,6 +56,7 @@ public:
         }
         history.append(commit);
         head++;
+        revision = ++lastRevision;
     }
     T current() {
         if (head < 0 || history.length() == 0) {
@@ -62,13 +70,34 @@ public:
     bool isSaved() {
         return saved == head;
     }
+    int length() {
+        return history.length();
+    }
+    T at(int i) {
+        return history.at(i);
+    }
+    void clear() {
+        history.clear();
+        head = -1;
+        saved = -1;
+        revision = ++lastRevision;
+    }
+    // Changes whenever the current item does. Unlike the item's address, it's never reused.
+    quint64 getRevision() {
+        return revision;
+    }
 
 private:
     QList<T> history;
     int head = -1;
     int saved = -1;
+    quint64 revision = 0;
+    static quint64 lastRevision;
 };
 
+template <typename T>
+quint64 History<T>::lastRevision = 0;
+
 class Connection {
 public:
     Connection() {
@@ -102,8 +131,13 @@ public:
     Blockdata *cached_blockdata = NULL;
     Blockdata *cached_collision = NULL;
     Blockdata *cached_border = NULL;
+    // Maps can share a layout, so the caches also record which map's image they match.
+    Map *cached_blockdata_map = NULL;
+    Map *cached_collision_map = NULL;
     bool has_unsaved_changes = false;
+    bool loaded = false; // layout.inc has been read. See Project::getMapLayout().
 public:
+    MemoryUsage memoryUsage();
     static QString getNameFromLabel(QString label) {
         // ASSUMPTION: strip off "_Layout" from layout label. Directories in 'data/layouts/' must be well-formed.
         return label.replace(label.lastIndexOf("_Layout"), label.length(), "");
@@ -136,6 +170,8 @@ public:
     MapLayout *layout;
 
     bool isPersistedToFile = true;
+    // Edits to the header or connections, which aren't in the history.
+    bool has_unsaved_changes = false;
 
 public:
     void setName(QString mapName);
@@ -150,12 +186,18 @@ public:
     int getDisplayedBlockIndex(int);
     QPixmap render(bool ignoreCache);
     QPixmap renderMetatiles();
+    bool hasCurrentRender();
 
     QPixmap renderCollision(bool ignoreCache);
+    bool hasCurrentCollisionRender();
     QImage collision_image;
     QPixmap collision_pixmap;
-    QImage getCollisionMetatileImage(Block);
-    QImage getCollisionMetatileImage(int, int);
+    Mipmaps collision_mipmaps;
+    void releaseRenders();
+    static QImage getCollisionMetatileImage(Block);
+    static QImage getCollisionMetatileImage(int, int);
+    static QImage renderBlocks(QList<Block> blocks, int width, int height, Tileset *primary, Tileset *secondary, bool collision);
+    bool setRender(QImage rendered, QList<Block> blocks, QPair<Tileset*, Tileset*> tilesets, bool collision);
     QPixmap renderCollisionMetatiles();
 
     void drawSelection(int i, int w, int selectionWidth, int selectionHeight, QPainter *painter, int gridWidth);
@@ -165,6 +207,10 @@ public:
     void cacheCollision();
     QImage image;
     QPixmap pixmap;
+    Mipmaps mipmaps;
+    // The tilesets image and collision_image were drawn with.
+    QPair<Tileset*, Tileset*> image_tilesets;
+    QPair<Tileset*, Tileset*> collision_image_tilesets;
     QList<QImage> metatile_images;
     bool smart_paths_enabled = false;
     int paint_metatile_initial_x;
@@ -177,6 +223,9 @@ public:
     int selected_metatiles_width;
     int selected_metatiles_height;
     QList<int> *selected_metatiles = NULL;
+    // The selection picked from the map, collision and elevation included. Empty when the
+    // selection came from the metatile picker, which only has metatiles.
+    BlockBuffer selected_blocks;
     int paint_collision;
     int paint_elevation;
 
@@ -184,6 +233,14 @@ public:
     void setBlock(int x, int y, Block block);
     void _setBlock(int x, int y, Block block);
 
+    // Bulk edits of rectangles of blocks. Each is a single undo step.
+    BlockBuffer copyBlocks(QRect rect);
+    void pasteBlocks(QPoint pos, BlockBuffer *buffer);
+    void fillBlocks(QRect rect, BlockBuffer *pattern, quint16 mask);
+    void moveBlocks(QRect rect, QPoint pos, BlockBuffer *fill, quint16 mask);
+    void _pasteBlocks(QPoint pos, BlockBuffer *buffer);
+    void _fillBlocks(QRect rect, BlockBuffer *pattern, quint16 mask);
+
     void floodFillCollision(int x, int y, uint collision);
     void _floodFillCollision(int x, int y, uint collision);
     void floodFillElevation(int x, int y, uint elevation);
@@ -195,11 +252,15 @@ public:
     void undo();
     void redo();
     void commit();
+    void clearHistory();
 
     QList<Event*> getAllEvents();
     void removeEvent(Event *event);
     void addEvent(Event *event);
     QMap<QString, QList<Event*>> events;
+    QList<quint64> getEventRevisions();
+    // The events' revisions when they were last loaded or saved.
+    QList<quint64> saved_event_revisions;
 
     QList<Connection*> connections;
     QPixmap renderConnection(Connection);
@@ -210,6 +271,10 @@ public:
     void cacheBorder();
 
     bool hasUnsavedChanges();
+
+    // Doesn't include the layout, which is accounted for separately since maps can share one.
+    MemoryUsage memoryUsage();
+
     void hoveredTileChanged(int x, int y, int block);
     void clearHoveredTile();
     void hoveredMetatileChanged(int block);
@@ -217,6 +282,8 @@ public:
     void hoveredMovementPermissionTileChanged(int collision, int elevation);
     void clearHoveredMovementPermissionTile();
     void setSelectedMetatilesFromTilePicker();
+    void setSelectedBlocks(BlockBuffer blocks);
+    void paintSelectedBlock(int index, Block *block);
 
 signals:
     void paintTileChanged(Map *map);
@@ -0,0 +1,248 @@
+#include "mapformat.h"
+
+#include <QDebug>
+#include <QDataStream>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QSettings>
+
+const int MapFormat::version = 1;
+const quint32 MapFormat::magic = 0x504d4150; // "PMAP"
+
+MapFormat::Format MapFormat::fromName(QString name) {
+    if (name == "json") {
+        return Json;
+    } else if (name == "binary") {
+        return Binary;
+    }
+    return Asm;
+}
+
+QString MapFormat::name(Format format) {
+    switch (format) {
+    case Json: return "json";
+    case Binary: return "binary";
+    default: return "asm";
+    }
+}
+
+static QString extension(MapFormat::Format format) {
+    return format == MapFormat::Binary ? "pmap" : "json";
+}
+
+QString MapFormat::mapPath(QString root, QString map_name, Format format) {
+    return QString("%1/data/maps/%2/map.%3").arg(root).arg(map_name).arg(extension(format));
+}
+
+QString MapFormat::layoutPath(QString root, QString layout_name, Format format) {
+    return QString("%1/data/layouts/%2/layout.%3").arg(root).arg(layout_name).arg(extension(format));
+}
+
+QString MapFormat::configPath(QString root) {
+    return root + "/pretmap.ini";
+}
+
+bool MapFormat::hasProjectFormat(QString root) {
+    QSettings config(configPath(root), QSettings::IniFormat);
+    return config.contains("map_format");
+}
+
+MapFormat::Format MapFormat::projectFormat(QString root) {
+    QSettings config(configPath(root), QSettings::IniFormat);
+    return fromName(config.value("map_format").toString());
+}
+
+void MapFormat::setProjectFormat(QString root, Format format) {
+    QSettings config(configPath(root), QSettings::IniFormat);
+    config.setValue("map_format", name(format));
+    config.sync();
+    if (config.status() != QSettings::NoError) {
+        qDebug() << QString("Could not write project config '%1'").arg(configPath(root));
+    }
+}
+
+QVariantMap MapFormat::fromMap(Map *map) {
+    QVariantMap header;
+    header.insert("layout", map->layout_label);
+    header.insert("events_label", map->events_label);
+    header.insert("scripts_label", map->scripts_label);
+    header.insert("connections_label", map->connections_label);
+    header.insert("song", map->song);
+    header.insert("layout_id", map->layout_id);
+    header.insert("location", map->location);
+    header.insert("requires_flash", map->requiresFlash);
+    header.insert("weather", map->weather);
+    header.insert("type", map->type);
+    header.insert("unknown", map->unknown);
+    header.insert("show_location", map->show_location);
+    header.insert("battle_scene", map->battle_scene);
+
+    QVariantList connections;
+    for (Connection *connection : map->connections) {
+        QVariantMap value;
+        value.insert("direction", connection->direction);
+        value.insert("offset", connection->offset);
+        value.insert("map", connection->map_name);
+        connections.append(value);
+    }
+
+    QVariantMap events;
+    for (QString group : map->events.keys()) {
+        QVariantList list;
+        for (Event *event : map->events.value(group)) {
+            QVariantMap values;
+            for (QString key : event->values.keys()) {
+                // The map name is implied by the file the event is in.
+                if (key != "map_name") {
+                    values.insert(key, event->values.value(key));
+                }
+            }
+            list.append(values);
+        }
+        events.insert(group, list);
+    }
+
+    QVariantMap document;
+    document.insert("version", version);
+    document.insert("name", map->name);
+    document.insert("header", header);
+    document.insert("connections", connections);
+    document.insert("events", events);
+    return document;
+}
+
+// Replaces the map's header, connections and events with the document's. The old connections
+// and events are deleted, so nothing may still point at them.
+bool MapFormat::toMap(QVariantMap document, Map *map) {
+    if (!checkVersion(document)) {
+        return false;
+    }
+    if (document.value("name").toString() != map->name) {
+        qDebug() << QString("Map document is for '%1', not '%2'").arg(document.value("name").toString()).arg(map->name);
+        return false;
+    }
+
+    QVariantMap header = document.value("header").toMap();
+    map->layout_label = header.value("layout").toString();
+    map->events_label = header.value("events_label").toString();
+    map->scripts_label = header.value("scripts_label").toString();
+    map->connections_label = header.value("connections_label").toString();
+    map->song = header.value("song").toString();
+    map->layout_id = header.value("layout_id").toString();
+    map->location = header.value("location").toString();
+    map->requiresFlash = header.value("requires_flash").toString();
+    map->weather = header.value("weather").toString();
+    map->type = header.value("type").toString();
+    map->unknown = header.value("unknown").toString();
+    map->show_location = header.value("show_location").toString();
+    map->battle_scene = header.value("battle_scene").toString();
+
+    qDeleteAll(map->connections);
+    map->connections.clear();
+    for (QVariant item : document.value("connections").toList()) {
+        QVariantMap value = item.toMap();
+        Connection *connection = new Connection;
+        connection->direction = value.value("direction").toString();
+        connection->offset = value.value("offset").toString();
+        connection->map_name = value.value("map").toString();
+        map->connections.append(connection);
+    }
+
+    QVariantMap events = document.value("events").toMap();
+    for (QString group : QStringList() << "object_event_group" << "warp_event_group" << "coord_event_group" << "bg_event_group") {
+        qDeleteAll(map->events[group]);
+        map->events[group].clear();
+        for (QVariant item : events.value(group).toList()) {
+            QVariantMap values = item.toMap();
+            Event *event = new Event;
+            event->put("map_name", map->name);
+            for (QString key : values.keys()) {
+                event->put(key, values.value(key).toString());
+            }
+            map->events[group].append(event);
+        }
+    }
+    return true;
+}
+
+QVariantMap MapFormat::fromLayout(MapLayout *layout) {
+    QVariantMap document;
+    document.insert("version", version);
+    document.insert("label", layout->label);
+    document.insert("width", layout->width);
+    document.insert("height", layout->height);
+    document.insert("border_label", layout->border_label);
+    document.insert("border_path", layout->border_path);
+    document.insert("blockdata_label", layout->blockdata_label);
+    document.insert("blockdata_path", layout->blockdata_path);
+    document.insert("primary_tileset", layout->tileset_primary_label);
+    document.insert("secondary_tileset", layout->tileset_secondary_label);
+    return document;
+}
+
+bool MapFormat::toLayout(QVariantMap document, MapLayout *layout) {
+    if (!checkVersion(document)) {
+        return false;
+    }
+    if (document.value("label").toString() != layout->label) {
+        qDebug() << QString("Layout document is for '%1', not '%2'").arg(document.value("label").toString()).arg(layout->label);
+        return false;
+    }
+    layout->width = document.value("width").toString();
+    layout->height = document.value("height").toString();
+    layout->border_label = document.value("border_label").toString();
+    layout->border_path = document.value("border_path").toString();
+    layout->blockdata_label = document.value("blockdata_label").toString();
+    layout->blockdata_path = document.value("blockdata_path").toString();
+    layout->tileset_primary_label = document.value("primary_tileset").toString();
+    layout->tileset_secondary_label = document.value("secondary_tileset").toString();
+    return true;
+}
+
+QByteArray MapFormat::write(QVariantMap document, Format format) {
+    if (format == Binary) {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << magic << document;
+        return data;
+    }
+    return QJsonDocument::fromVariant(document).toJson(QJsonDocument::Indented);
+}
+
+bool MapFormat::read(QByteArray data, Format format, QVariantMap *document) {
+    if (format == Binary) {
+        QDataStream in(data);
+        in.setVersion(QDataStream::Qt_5_0);
+        quint32 dataMagic;
+        in >> dataMagic;
+        if (dataMagic != magic) {
+            qDebug() << "Not a pretmap binary map document";
+            return false;
+        }
+        in >> *document;
+        if (in.status() != QDataStream::Ok) {
+            qDebug() << "Binary map document is corrupt";
+            return false;
+        }
+        return true;
+    }
+
+    QJsonParseError error;
+    QJsonDocument json = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError) {
+        qDebug() << QString("Failed to parse map document at offset %1: ").arg(error.offset) + error.errorString();
+        return false;
+    }
+    *document = json.toVariant().toMap();
+    return true;
+}
+
+bool MapFormat::checkVersion(QVariantMap document) {
+    int documentVersion = document.value("version").toInt();
+    if (documentVersion < 1 || documentVersion > version) {
+        qDebug() << QString("Unsupported map document version %1 (expected at most %2)").arg(documentVersion).arg(version);
+        return false;
+    }
+    return true;
+}
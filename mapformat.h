@@ -0,0 +1,51 @@
+#ifndef MAPFORMAT_H
+#define MAPFORMAT_H
+
+#include "map.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QVariantMap>
+
+// Map headers, events, connections and layouts can also be stored outside of asm,
+// so other tools can read them without an asm parser. JSON is meant for diffing,
+// and the binary form (the same document in a QDataStream) for fast reading.
+// Both hold exactly the strings the asm does, so maps round-trip without loss.
+class MapFormat
+{
+public:
+    enum Format {
+        Asm,
+        Json,
+        Binary,
+    };
+
+    // Bump this whenever the document layout changes.
+    static const int version;
+    static const quint32 magic;
+
+    static Format fromName(QString name);
+    static QString name(Format format);
+    static QString mapPath(QString root, QString map_name, Format format);
+    static QString layoutPath(QString root, QString layout_name, Format format);
+
+    // Which format a project's maps are read from is kept in the project itself
+    // (pretmap.ini at its root), so everyone working on it reads the same files.
+    static QString configPath(QString root);
+    static bool hasProjectFormat(QString root);
+    static Format projectFormat(QString root);
+    static void setProjectFormat(QString root, Format format);
+
+    static QVariantMap fromMap(Map *map);
+    static bool toMap(QVariantMap document, Map *map);
+    static QVariantMap fromLayout(MapLayout *layout);
+    static bool toLayout(QVariantMap document, MapLayout *layout);
+
+    static QByteArray write(QVariantMap document, Format format);
+    static bool read(QByteArray data, Format format, QVariantMap *document);
+
+private:
+    static bool checkVersion(QVariantMap document);
+};
+
+#endif // MAPFORMAT_H
@@ -0,0 +1,257 @@
+#include "mapprefetcher.h"
+#include "editor.h"
+#include "tracing.h"
+
+#include <QApplication>
+#include <QEvent>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QtConcurrent/QtConcurrentRun>
+
+MapPrefetcher::MapPrefetcher(Editor *editor, QObject *parent) : QObject(parent)
+{
+    this->editor = editor;
+    idleTimer.setSingleShot(true);
+    stepTimer.setSingleShot(true);
+    connect(&idleTimer, SIGNAL(timeout()), this, SLOT(prefetchNext()));
+    connect(&stepTimer, SIGNAL(timeout()), this, SLOT(prefetchNext()));
+    qApp->installEventFilter(this);
+}
+
+// Queues the maps linked to the current map. Their layouts are read in the background right away,
+// even if prefetching the maps themselves is turned off.
+void MapPrefetcher::schedule() {
+    idleTimer.stop();
+    stepTimer.stop();
+    pending.clear();
+    step = 0;
+    if (project != editor->project) {
+        project = editor->project;
+        prefetched.clear();
+    }
+    if (!project || !editor->map) {
+        return;
+    }
+    QStringList linked = project->getLinkedMapNames(editor->map);
+    project->prefetchMapLayouts(linked);
+    if (!project->prefetch_maps) {
+        return;
+    }
+    prefetched.removeAll(editor->map->name);
+
+    for (QString map_name : linked) {
+        Map *map = project->map_cache->value(map_name);
+        if (!map || !map->hasCurrentRender() || !map->hasCurrentCollisionRender()) {
+            pending.append(map_name);
+        }
+    }
+    if (!pending.isEmpty()) {
+        idleTimer.start(idleDelay);
+    }
+}
+
+// Stops prefetching, and waits for the work in the background, since it uses the project's tilesets.
+// Call this before tilesets are replaced or the project is closed.
+void MapPrefetcher::stop() {
+    idleTimer.stop();
+    stepTimer.stop();
+    pending.clear();
+    step = 0;
+    generation++;
+    work.waitForFinished();
+}
+
+bool MapPrefetcher::eventFilter(QObject *watched, QEvent *event) {
+    if (!pending.isEmpty()) {
+        switch (event->type()) {
+        case QEvent::MouseButtonPress:
+        case QEvent::MouseButtonRelease:
+        case QEvent::MouseButtonDblClick:
+        case QEvent::KeyPress:
+        case QEvent::Wheel:
+            stepTimer.stop();
+            idleTimer.start(idleDelay);
+            break;
+        case QEvent::MouseMove:
+            if (QApplication::mouseButtons() != Qt::NoButton) {
+                stepTimer.stop();
+                idleTimer.start(idleDelay);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void MapPrefetcher::prefetchNext() {
+    if (pending.isEmpty() || project != editor->project || !editor->map) {
+        return;
+    }
+    // The next step starts once the work in the background is done.
+    if (!work.isFinished()) {
+        return;
+    }
+    if (!makeRoom()) {
+        pending.clear();
+        step = 0;
+        return;
+    }
+
+    // Each step is separate, so input only ever has to wait for one of them.
+    QString map_name = pending.first();
+    TRACE_ZONE("MapPrefetcher::prefetchNext", "project");
+    if (step == 0) {
+        step++;
+        // Decoding the tilesets is most of the cost of loading a map.
+        if (!project->map_cache->contains(map_name)) {
+            readTilesets(map_name);
+            return;
+        }
+    }
+    Map *map = project->getMap(map_name);
+    if (!map || !map->layout || !map->layout->blockdata) {
+        pending.removeFirst();
+        step = 0;
+    } else if (step == 1) {
+        step++;
+    } else if (step == 2) {
+        step++;
+        if (!map->hasCurrentRender()) {
+            renderMap(map, false);
+            return;
+        }
+    } else if (step == 3) {
+        step++;
+        if (!map->hasCurrentCollisionRender()) {
+            renderMap(map, true);
+            return;
+        }
+    } else {
+        loadEventSprites(map);
+        prefetched.removeAll(map_name);
+        prefetched.append(map_name);
+        pending.removeFirst();
+        step = 0;
+    }
+    if (!pending.isEmpty()) {
+        stepTimer.start(0);
+    }
+}
+
+// Reads the tilesets of a map that isn't loaded yet, so loading it only finds them in the cache.
+void MapPrefetcher::readTilesets(QString map_name) {
+    Project *project = this->project;
+    QStringList cached = project->tileset_cache->keys();
+    int generation = this->generation;
+    QFutureWatcher<QMap<QString, Tileset*>> *watcher = new QFutureWatcher<QMap<QString, Tileset*>>(this);
+    connect(watcher, &QFutureWatcher<QMap<QString, Tileset*>>::finished, [=]() {
+        watcher->deleteLater();
+        QMap<QString, Tileset*> tilesets = watcher->result();
+        if (generation != this->generation || project != editor->project) {
+            for (Tileset *tileset : tilesets.values()) {
+                project->deleteTileset(tileset);
+            }
+            return;
+        }
+        for (QString label : tilesets.keys()) {
+            project->cacheTileset(label, tilesets.value(label));
+        }
+        resume();
+    });
+    QFuture<QMap<QString, Tileset*>> future = QtConcurrent::run([project, map_name, cached]() {
+        QMap<QString, Tileset*> tilesets;
+        for (QString label : project->readMapTilesetLabels(map_name)) {
+            if (!label.isEmpty() && !cached.contains(label) && !tilesets.contains(label)) {
+                tilesets.insert(label, project->readTileset(label));
+            }
+        }
+        return tilesets;
+    });
+    watcher->setFuture(future);
+    work = future;
+}
+
+// Draws the map, or its collision, from a copy of its blocks in the background. The map only
+// takes the image if it hasn't changed in the meantime.
+void MapPrefetcher::renderMap(Map *map, bool collision) {
+    Project *project = this->project;
+    QString map_name = map->name;
+    QList<Block> blocks = *map->layout->blockdata->blocks;
+    int width = map->getWidth();
+    int height = map->getHeight();
+    QPair<Tileset*, Tileset*> tilesets = qMakePair(map->layout->tileset_primary, map->layout->tileset_secondary);
+    int generation = this->generation;
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, [=]() {
+        watcher->deleteLater();
+        if (generation != this->generation || project != editor->project) {
+            return;
+        }
+        Map *map = project->map_cache->value(map_name);
+        if (map) {
+            map->setRender(watcher->result(), blocks, tilesets, collision);
+        }
+        resume();
+    });
+    QFuture<QImage> future = QtConcurrent::run([blocks, width, height, tilesets, collision]() {
+        return Map::renderBlocks(blocks, width, height, tilesets.first, tilesets.second, collision);
+    });
+    watcher->setFuture(future);
+    work = future;
+}
+
+// Carries on after work in the background, unless there's been input since it started.
+void MapPrefetcher::resume() {
+    if (!pending.isEmpty() && !idleTimer.isActive()) {
+        stepTimer.start(0);
+    }
+}
+
+// Decodes the sprites of the map's object events in the background, like Editor::loadEventSprites.
+void MapPrefetcher::loadEventSprites(Map *map) {
+    QStringList sprites = project->applyEventPixmaps(map->getAllEvents());
+    if (sprites.isEmpty()) {
+        return;
+    }
+    Project *project = this->project;
+    QFutureWatcher<QMap<QString, QImage>> *watcher = new QFutureWatcher<QMap<QString, QImage>>(this);
+    connect(watcher, &QFutureWatcher<QMap<QString, QImage>>::finished, [=]() {
+        watcher->deleteLater();
+        if (project == editor->project) {
+            project->cacheEventObjectSpriteImages(watcher->result());
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([project, sprites]() {
+        return project->readEventObjectSpriteImages(sprites);
+    }));
+}
+
+// Releases the renders of maps that were prefetched but never opened, oldest first,
+// until the map cache is under budget. Returns false if there's no room left.
+bool MapPrefetcher::makeRoom() {
+    QStringList linked = project->getLinkedMapNames(editor->map);
+    QStringList releasable;
+    for (QString map_name : prefetched) {
+        if (!linked.contains(map_name) && map_name != editor->map->name) {
+            releasable.append(map_name);
+        }
+    }
+    // Adding up the cache is slow, so it's only done once, and each release is taken off the total.
+    qint64 bytes = project->getMapCacheBytes();
+    while (bytes >= project->map_cache_budget) {
+        if (releasable.isEmpty()) {
+            return false;
+        }
+        QString map_name = releasable.takeFirst();
+        prefetched.removeAll(map_name);
+        Map *map = project->map_cache->value(map_name);
+        if (map) {
+            qint64 before = map->memoryUsage().total();
+            map->releaseRenders();
+            bytes -= before - map->memoryUsage().total();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef MAPPREFETCHER_H
+#define MAPPREFETCHER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QStringList>
+#include <QFuture>
+
+class Editor;
+class Project;
+class Map;
+
+// Loads and renders the maps the current map connects or warps to while the editor
+// is idle, so moving to one of them doesn't have to wait for it. One step is done per
+// pass through the event loop, and any input puts it off until things are idle again.
+// Reading tilesets and rendering happen on other threads; only parsing the map is left
+// on the main thread, since it fills in the project's tables.
+class MapPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    MapPrefetcher(Editor *editor, QObject *parent = 0);
+    static const int idleDelay = 500;
+
+    void schedule();
+    void stop();
+
+protected:
+    virtual bool eventFilter(QObject *watched, QEvent *event);
+
+private slots:
+    void prefetchNext();
+
+private:
+    bool makeRoom();
+    void readTilesets(QString map_name);
+    void renderMap(Map *map, bool collision);
+    void resume();
+    void loadEventSprites(Map *map);
+
+    Editor *editor;
+    Project *project = NULL;
+    QTimer idleTimer;
+    QTimer stepTimer;
+    QStringList pending;
+    // How far along the first pending map is: tilesets read, loaded, rendered, collision rendered.
+    int step = 0;
+    // The tileset read or render running in the background. Only one runs at a time.
+    QFuture<void> work;
+    // Bumped by stop(), so work that finishes afterwards is dropped.
+    int generation = 0;
+    // Maps rendered here that haven't been opened since. Their renders are released first.
+    QStringList prefetched;
+};
+
+#endif // MAPPREFETCHER_H
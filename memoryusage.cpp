@@ -0,0 +1,72 @@
+#include "memoryusage.h"
+#include "blockdata.h"
+
+#include <algorithm>
+
+void MemoryUsage::add(QString category, qint64 bytes) {
+    categories[category] += bytes;
+}
+
+void MemoryUsage::add(const MemoryUsage &other) {
+    for (QString category : other.categories.keys()) {
+        add(category, other.categories.value(category));
+    }
+}
+
+qint64 MemoryUsage::value(QString category) const {
+    return categories.value(category);
+}
+
+qint64 MemoryUsage::total() const {
+    qint64 bytes = 0;
+    for (qint64 value : categories.values()) {
+        bytes += value;
+    }
+    return bytes;
+}
+
+QStringList MemoryUsage::report() const {
+    QList<QPair<qint64, QString>> sorted;
+    for (QString category : categories.keys()) {
+        sorted.append(qMakePair(categories.value(category), category));
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const QPair<qint64, QString> &a, const QPair<qint64, QString> &b) {
+        return a.first > b.first;
+    });
+
+    QStringList lines;
+    for (QPair<qint64, QString> entry : sorted) {
+        lines << QString("%1  %2").arg(formatBytes(entry.first), 10).arg(entry.second);
+    }
+    lines << QString("%1  total").arg(formatBytes(total()), 10);
+    return lines;
+}
+
+qint64 MemoryUsage::imageBytes(const QImage &image) {
+    return image.byteCount();
+}
+
+qint64 MemoryUsage::pixmapBytes(const QPixmap &pixmap) {
+    return qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+}
+
+qint64 MemoryUsage::blockdataBytes(Blockdata *blockdata) {
+    if (!blockdata || !blockdata->blocks) {
+        return 0;
+    }
+    return qint64(blockdata->blocks->length()) * sizeof(Block);
+}
+
+qint64 MemoryUsage::stringBytes(const QString &string) {
+    return qint64(string.size()) * sizeof(QChar);
+}
+
+QString MemoryUsage::formatBytes(qint64 bytes) {
+    if (bytes < 1024) {
+        return QString("%1 B").arg(bytes);
+    }
+    if (bytes < 1024 * 1024) {
+        return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 1);
+    }
+    return QString("%1 MB").arg(bytes / (1024.0 * 1024.0), 0, 'f', 1);
+}
@@ -0,0 +1,35 @@
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QImage>
+#include <QPixmap>
+
+class Blockdata;
+
+// Approximate bytes held by something, broken down by category.
+// Only the data is counted, not allocator or container overhead,
+// and implicitly shared data is counted by everything that holds it.
+class MemoryUsage
+{
+public:
+    QMap<QString, qint64> categories;
+
+    void add(QString category, qint64 bytes);
+    void add(const MemoryUsage &other);
+    qint64 value(QString category) const;
+    qint64 total() const;
+
+    // One line per category, largest first, then the total.
+    QStringList report() const;
+
+    static qint64 imageBytes(const QImage &image);
+    static qint64 pixmapBytes(const QPixmap &pixmap);
+    static qint64 blockdataBytes(Blockdata *blockdata);
+    static qint64 stringBytes(const QString &string);
+    static QString formatBytes(qint64 bytes);
+};
+
+#endif // MEMORYUSAGE_H
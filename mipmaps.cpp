@@ -0,0 +1,87 @@
+#include "mipmaps.h"
+
+#include <QtMath>
+
+void Mipmaps::update(const QImage &image, QRect dirty) {
+    if (image.isNull()) {
+        clear();
+        return;
+    }
+
+    // Round the region out to whole pixels of the smallest level.
+    int align = 1 << levels;
+    int left = dirty.left() / align * align;
+    int top = dirty.top() / align * align;
+    int right = (dirty.right() / align + 1) * align;
+    int bottom = (dirty.bottom() / align + 1) * align;
+    QRect rect = QRect(left, top, right - left, bottom - top).intersected(image.rect());
+
+    const QImage *source = &image;
+    for (int level = 0; level < levels; level++) {
+        QSize size((source->width() + 1) / 2, (source->height() + 1) / 2);
+        if (images[level].size() != size || images[level].format() != image.format()) {
+            images[level] = QImage(size, image.format());
+            images[level].fill(0);
+            rect = source->rect();
+        }
+        downsample(*source, &images[level], rect);
+        stale[level] = true;
+        source = &images[level];
+        rect = QRect(rect.left() / 2, rect.top() / 2, (rect.width() + 1) / 2, (rect.height() + 1) / 2);
+    }
+}
+
+qint64 Mipmaps::bytes() {
+    qint64 bytes = 0;
+    for (int level = 0; level < levels; level++) {
+        bytes += images[level].byteCount();
+        bytes += qint64(pixmaps[level].width()) * pixmaps[level].height() * pixmaps[level].depth() / 8;
+    }
+    return bytes;
+}
+
+void Mipmaps::clear() {
+    for (int level = 0; level < levels; level++) {
+        images[level] = QImage();
+        pixmaps[level] = QPixmap();
+        stale[level] = false;
+    }
+}
+
+QPixmap Mipmaps::pixmap(int level) {
+    int i = level - 1;
+    if (i < 0 || i >= levels) {
+        return QPixmap();
+    }
+    if (stale[i]) {
+        pixmaps[i] = QPixmap::fromImage(images[i]);
+        stale[i] = false;
+    }
+    return pixmaps[i];
+}
+
+int Mipmaps::levelForDetail(qreal detail) {
+    if (detail <= 0 || detail >= 1) {
+        return 0;
+    }
+    // The smallest level that still has at least one pixel per screen pixel.
+    return qMin(int(qFloor(-qLn(detail) / qLn(2))), levels);
+}
+
+// Averages each 2x2 block of source pixels in rect into one destination pixel.
+// Works on any 32-bit format, since every channel is averaged the same way.
+void Mipmaps::downsample(const QImage &source, QImage *destination, QRect rect) {
+    rect = rect.intersected(source.rect());
+    for (int y = rect.top() / 2; y <= rect.bottom() / 2 && y < destination->height(); y++) {
+        const uchar *row0 = source.constScanLine(y * 2);
+        const uchar *row1 = source.constScanLine(qMin(y * 2 + 1, source.height() - 1));
+        uchar *out = destination->scanLine(y);
+        for (int x = rect.left() / 2; x <= rect.right() / 2 && x < destination->width(); x++) {
+            int x0 = x * 2 * 4;
+            int x1 = qMin(x * 2 + 1, source.width() - 1) * 4;
+            for (int c = 0; c < 4; c++) {
+                out[x * 4 + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4;
+            }
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef MIPMAPS_H
+#define MIPMAPS_H
+
+#include <QImage>
+#include <QPixmap>
+#include <QRect>
+
+// Downscaled copies of an image at 1/2, 1/4 and 1/8 size. Each level is a box filter
+// of the one above it, so only the part of each level under a changed region has to
+// be rebuilt. Used to draw zoomed out views without aliasing.
+class Mipmaps
+{
+public:
+    static const int levels = 3;
+
+    // Rebuilds the region of every level that covers dirty (in pixels of image).
+    // The levels are reallocated if the image changed size.
+    void update(const QImage &image, QRect dirty);
+    void clear();
+
+    // Level 0 is the image itself, which isn't stored here.
+    QPixmap pixmap(int level);
+
+    // The level to draw with at a given level of detail (screen pixels per image pixel).
+    static int levelForDetail(qreal detail);
+
+    qint64 bytes();
+
+private:
+    static void downsample(const QImage &source, QImage *destination, QRect rect);
+
+    QImage images[levels];
+    QPixmap pixmaps[levels];
+    bool stale[levels] = {};
+};
+
+#endif // MIPMAPS_H
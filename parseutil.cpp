@@ -1,4 +1,5 @@
 #include "parseutil.h"
+#include "tracing.h"
 
 #include <QDebug>
 #include <QRegularExpression>
@@ -23,6 +24,7 @@ void ParseUtil::strip_comment(QString *line) {
 }
 
 QList<QStringList>* ParseUtil::parseAsm(QString text) {
+    TRACE_ZONE("ParseUtil::parseAsm", "parse");
     QList<QStringList> *parsed = new QList<QStringList>;
     QStringList lines = text.split('\n');
     for (QString line : lines) {
@@ -197,3 +199,61 @@ int ParseUtil::evaluatePostfix(QList<Token> postfix) {
 
     return stack.pop().value.toInt(nullptr, 0);
 }
+
+AsmLabelIndex::AsmLabelIndex(QList<QStringList> *commands, QString path) {
+    this->commands = *commands;
+
+    QStringList open_labels;
+    int start = -1;
+    int i = 0;
+    for (; i < this->commands.length(); i++) {
+        QStringList params = this->commands.value(i);
+        if (params.value(0) == ".label") {
+            if (start != -1) {
+                for (QString label : open_labels) {
+                    ranges.insert(label, QPair<int, int>(start, i));
+                }
+                open_labels.clear();
+                start = -1;
+            }
+            QString label = params.value(1);
+            if (ranges.contains(label)) {
+                qDebug() << QString("Ignoring duplicate label '%1' in '%2'. The first definition is used.").arg(label).arg(path);
+            } else if (!open_labels.contains(label)) {
+                open_labels.append(label);
+            }
+        } else if (start == -1 && !open_labels.isEmpty()) {
+            start = i;
+        }
+    }
+    for (QString label : open_labels) {
+        ranges.insert(label, QPair<int, int>(start == -1 ? i : start, i));
+    }
+}
+
+bool AsmLabelIndex::contains(QString label) {
+    return ranges.contains(label);
+}
+
+QList<QStringList> AsmLabelIndex::macros(QString label) {
+    if (!ranges.contains(label)) {
+        return QList<QStringList>();
+    }
+    QPair<int, int> range = ranges.value(label);
+    return commands.mid(range.first, range.second - range.first);
+}
+
+// For if you don't care about filtering by macro,
+// and just want all values associated with some label.
+QStringList AsmLabelIndex::values(QString label) {
+    QStringList values;
+    for (QStringList params : macros(label)) {
+        QString macro = params.value(0);
+        if (macro == ".align" || macro == ".ifdef" || macro == ".ifndef")
+            continue;
+        for (int j = 1; j < params.length(); j++) {
+            values.append(params.value(j));
+        }
+    }
+    return values;
+}
@@ -4,6 +4,8 @@
 #include <QString>
 #include <QList>
 #include <QMap>
+#include <QPair>
+#include <QStringList>
 
 enum TokenType {
     Number,
@@ -41,4 +43,21 @@ private:
     int evaluatePostfix(QList<Token> postfix);
 };
 
+// Maps every label in a parsed asm file to the range of macros that follow it,
+// so any number of labels can be looked up after a single pass over the file.
+// Follows the same rules as Project::getLabelMacros: stacked labels share the
+// macros below them, and the first definition of a label wins. Later definitions
+// are ignored, and logged along with path.
+class AsmLabelIndex
+{
+public:
+    AsmLabelIndex(QList<QStringList> *commands, QString path = QString());
+    bool contains(QString label);
+    QList<QStringList> macros(QString label);
+    QStringList values(QString label);
+private:
+    QList<QStringList> commands;
+    QMap<QString, QPair<int, int>> ranges;
+};
+
 #endif // PARSEUTIL_H
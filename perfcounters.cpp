@@ -0,0 +1,3 @@
+#include "perfcounters.h"
+
+QAtomicInt PerfCounters::counters[PerfCounters::NumCounters];
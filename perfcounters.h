@@ -0,0 +1,33 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <QAtomicInt>
+
+// Running totals of work done and cache lookups, shown in the performance overlay.
+// Counting is a relaxed atomic add, so it's safe and cheap from any thread.
+class PerfCounters
+{
+public:
+    enum Counter {
+        MetatilesRendered,
+        MapCacheHits,
+        MapCacheMisses,
+        TilesetCacheHits,
+        TilesetCacheMisses,
+        ProjectCacheHits,
+        ProjectCacheMisses,
+        NumCounters
+    };
+
+    static void add(Counter counter, int amount = 1) {
+        counters[counter].fetchAndAddRelaxed(amount);
+    }
+    static int value(Counter counter) {
+        return counters[counter].load();
+    }
+
+private:
+    static QAtomicInt counters[NumCounters];
+};
+
+#endif // PERFCOUNTERS_H
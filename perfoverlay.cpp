@@ -0,0 +1,83 @@
+#include "perfoverlay.h"
+#include "editor.h"
+
+#include <QFontDatabase>
+
+PerformanceOverlay::PerformanceOverlay(Editor *editor, QWidget *parent) : QLabel(parent)
+{
+    this->editor = editor;
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 180); color: white; padding: 6px; }");
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    move(8, 8);
+    connect(&timer, SIGNAL(timeout()), this, SLOT(updateCounters()));
+}
+
+void PerformanceOverlay::showEvent(QShowEvent *event) {
+    lastMetatilesRendered = PerfCounters::value(PerfCounters::MetatilesRendered);
+    interval.start();
+    updateCounters();
+    timer.start(1000);
+    QLabel::showEvent(event);
+}
+
+void PerformanceOverlay::hideEvent(QHideEvent *event) {
+    timer.stop();
+    QLabel::hideEvent(event);
+}
+
+QString PerformanceOverlay::formatHitRate(int hits, int misses) {
+    int lookups = hits + misses;
+    if (!lookups) {
+        return "no lookups";
+    }
+    return QString("%1% of %2").arg(100.0 * hits / lookups, 0, 'f', 1).arg(lookups);
+}
+
+void PerformanceOverlay::updateCounters() {
+    int metatiles = PerfCounters::value(PerfCounters::MetatilesRendered);
+    qint64 elapsed = qMax(qint64(1), interval.restart());
+    double metatilesPerSecond = (metatiles - lastMetatilesRendered) * 1000.0 / elapsed;
+    lastMetatilesRendered = metatiles;
+
+    QStringList lines;
+    lines << QString("Metatiles rendered  %1/s").arg(metatilesPerSecond, 0, 'f', 0);
+    lines << QString("Map cache           %1").arg(formatHitRate(PerfCounters::value(PerfCounters::MapCacheHits), PerfCounters::value(PerfCounters::MapCacheMisses)));
+    lines << QString("Tileset cache       %1").arg(formatHitRate(PerfCounters::value(PerfCounters::TilesetCacheHits), PerfCounters::value(PerfCounters::TilesetCacheMisses)));
+    lines << QString("Project cache       %1").arg(formatHitRate(PerfCounters::value(PerfCounters::ProjectCacheHits), PerfCounters::value(PerfCounters::ProjectCacheMisses)));
+
+    Project *project = editor->project;
+    if (project) {
+        // Also measured again as soon as a map is loaded or a project opened.
+        if (project != mapMemoryProject || project->map_cache->size() != mapMemoryMapCount
+         || !mapMemoryAge.isValid() || mapMemoryAge.elapsed() >= memoryInterval) {
+            mapMemory = MemoryUsage();
+            for (Map *map : project->map_cache->values()) {
+                mapMemory.add(map->memoryUsage());
+            }
+            for (MapLayout *layout : project->mapLayouts.values()) {
+                mapMemory.add(layout->memoryUsage());
+            }
+            mapMemoryProject = project;
+            mapMemoryMapCount = project->map_cache->size();
+            mapMemoryAge.start();
+        }
+        qint64 history = mapMemory.value("undo history");
+        lines << QString("Loaded maps         %1 in %2 maps").arg(MemoryUsage::formatBytes(mapMemory.total() - history)).arg(project->map_cache->size());
+        // Tileset data is interned, so the pool holds all of it, once.
+        lines << QString("Loaded tilesets     %1 in %2 tilesets (%3 before sharing)")
+                 .arg(MemoryUsage::formatBytes(project->assets->bytesStored()))
+                 .arg(project->tileset_cache->size())
+                 .arg(MemoryUsage::formatBytes(project->assets->bytesRequested()));
+        lines << QString("Undo history        %1").arg(MemoryUsage::formatBytes(history));
+    }
+    if (editor->scene) {
+        lines << QString("Scene items         %1").arg(editor->scene->items().length());
+    }
+    if (editor->last_display_map_ms >= 0) {
+        lines << QString("Last displayMap     %1 ms").arg(editor->last_display_map_ms);
+    }
+
+    setText(lines.join("\n"));
+    adjustSize();
+}
@@ -0,0 +1,44 @@
+#ifndef PERFOVERLAY_H
+#define PERFOVERLAY_H
+
+#include "perfcounters.h"
+#include "memoryusage.h"
+
+#include <QLabel>
+#include <QTimer>
+#include <QElapsedTimer>
+
+class Editor;
+class Project;
+
+// Live performance numbers drawn over the corner of the map view.
+// Only updates while it's visible.
+class PerformanceOverlay : public QLabel
+{
+    Q_OBJECT
+public:
+    PerformanceOverlay(Editor *editor, QWidget *parent = 0);
+    // Measuring the maps' memory walks every block and image, so it's done less often than the rest.
+    static const int memoryInterval = 10000;
+
+protected:
+    virtual void showEvent(QShowEvent *event);
+    virtual void hideEvent(QHideEvent *event);
+
+private slots:
+    void updateCounters();
+
+private:
+    static QString formatHitRate(int hits, int misses);
+
+    Editor *editor;
+    QTimer timer;
+    QElapsedTimer interval;
+    int lastMetatilesRendered = 0;
+    MemoryUsage mapMemory;
+    QElapsedTimer mapMemoryAge;
+    Project *mapMemoryProject = NULL;
+    int mapMemoryMapCount = -1;
+};
+
+#endif // PERFOVERLAY_H
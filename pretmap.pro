@@ -6,7 +6,7 @@
 
 QT       += core gui
 
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets concurrent
 
 TARGET = pretmap
 TEMPLATE = app
@@ -17,6 +17,7 @@ SOURCES += main.cpp\
     project.cpp \
     map.cpp \
     blockdata.cpp \
+    blockbuffer.cpp \
     block.cpp \
     tileset.cpp \
     tile.cpp \
@@ -27,12 +28,30 @@ SOURCES += main.cpp\
     parseutil.cpp \
     neweventtoolbutton.cpp \
     noscrollcombobox.cpp \
-    noscrollspinbox.cpp
+    noscrollspinbox.cpp \
+    projectcache.cpp \
+    lz77.cpp \
+    savetransaction.cpp \
+    textwriter.cpp \
+    journal.cpp \
+    projectwatcher.cpp \
+    mapformat.cpp \
+    batch.cpp \
+    worldatlas.cpp \
+    worldview.cpp \
+    mipmaps.cpp \
+    assetpool.cpp \
+    tracing.cpp \
+    perfcounters.cpp \
+    perfoverlay.cpp \
+    mapprefetcher.cpp \
+    memoryusage.cpp
 
 HEADERS  += mainwindow.h \
     project.h \
     map.h \
     blockdata.h \
+    blockbuffer.h \
     block.h \
     tileset.h \
     tile.h \
@@ -43,7 +62,24 @@ HEADERS  += mainwindow.h \
     parseutil.h \
     neweventtoolbutton.h \
     noscrollcombobox.h \
-    noscrollspinbox.h
+    noscrollspinbox.h \
+    projectcache.h \
+    lz77.h \
+    savetransaction.h \
+    textwriter.h \
+    journal.h \
+    projectwatcher.h \
+    mapformat.h \
+    batch.h \
+    worldatlas.h \
+    worldview.h \
+    mipmaps.h \
+    assetpool.h \
+    tracing.h \
+    perfcounters.h \
+    perfoverlay.h \
+    mapprefetcher.h \
+    memoryusage.h
 
 FORMS    += mainwindow.ui \
     objectpropertiesframe.ui
@@ -3,14 +3,27 @@
 #include "tile.h"
 #include "tileset.h"
 #include "event.h"
+#include "lz77.h"
+#include "textwriter.h"
+#include "projectwatcher.h"
+#include "tracing.h"
+#include "perfcounters.h"
 
 #include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QTextStream>
 #include <QStandardItem>
 #include <QMessageBox>
 #include <QRegularExpression>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
 
 Project::Project()
 {
@@ -32,6 +45,7 @@ Project::Project()
     mapConstantsToMapNames = new QMap<QString, QString>;
     mapNamesToMapConstants = new QMap<QString, QString>;
     tileset_cache = new QMap<QString, Tileset*>;
+    assets = new AssetPool;
 }
 
 QString Project::getProjectTitle() {
@@ -43,48 +57,66 @@ QString Project::getProjectTitle() {
 }
 
 Map* Project::loadMap(QString map_name) {
+    TRACE_ZONE("Project::loadMap", "project");
     Map *map;
     if (map_cache->contains(map_name)) {
+        PerfCounters::add(PerfCounters::MapCacheHits);
         map = map_cache->value(map_name);
         // TODO: uncomment when undo/redo history is fully implemented for all actions.
         if (true/*map->hasUnsavedChanges()*/) {
             return map;
         }
     } else {
+        PerfCounters::add(PerfCounters::MapCacheMisses);
         map = new Map;
         map->setName(map_name);
     }
 
-    readMapHeader(map);
-    readMapLayout(map);
-    readMapEvents(map);
-    loadMapConnections(map);
+    readMap(map);
     map->commit();
     map->history.save();
+    map->saved_event_revisions = map->getEventRevisions();
+    updateJournalSnapshot(map);
+    if (watcher) {
+        watcher->watchMap(map);
+    }
 
     map_cache->insert(map_name, map);
     return map;
 }
 
+void Project::readMap(Map *map) {
+    if (readMapDocument(map)) {
+        return;
+    }
+    readMapHeader(map);
+    readMapLayout(map);
+    readMapEvents(map);
+    loadMapConnections(map);
+}
+
 void Project::loadMapConnections(Map *map) {
+    TRACE_ZONE("Project::loadMapConnections", "project");
     if (!map->isPersistedToFile) {
         return;
     }
 
+    qDeleteAll(map->connections);
     map->connections.clear();
     if (!map->connections_label.isNull()) {
         QString path = root + QString("/data/maps/%1/connections.inc").arg(map->name);
         QString text = readTextFile(path);
         if (!text.isNull()) {
             QList<QStringList> *commands = parseAsm(text);
-            QStringList *list = getLabelValues(commands, map->connections_label);
+            AsmLabelIndex index(commands, path);
+            delete commands;
+            QStringList list = index.values(map->connections_label);
 
             //// Avoid using this value. It ought to be generated instead.
-            //int num_connections = list->value(0).toInt(nullptr, 0);
+            //int num_connections = list.value(0).toInt(nullptr, 0);
 
-            QString connections_list_label = list->value(1);
-            QList<QStringList> *connections = getLabelMacros(commands, connections_list_label);
-            for (QStringList command : *connections) {
+            QString connections_list_label = list.value(1);
+            for (QStringList command : index.macros(connections_list_label)) {
                 QString macro = command.value(0);
                 if (macro == "connection") {
                     Connection *connection = new Connection;
@@ -153,31 +185,34 @@ QStringList* Project::getLabelValues(QList<QStringList> *list, QString label) {
 }
 
 void Project::readMapHeader(Map* map) {
+    TRACE_ZONE("Project::readMapHeader", "parse");
     if (!map->isPersistedToFile) {
         return;
     }
 
     QString label = map->name;
-    ParseUtil *parser = new ParseUtil;
 
-    QString header_text = readTextFile(root + "/data/maps/" + label + "/header.inc");
+    QString header_path = root + "/data/maps/" + label + "/header.inc";
+    QString header_text = readTextFile(header_path);
     if (header_text.isNull()) {
         return;
     }
-    QStringList *header = getLabelValues(parser->parseAsm(header_text), label);
-    map->layout_label = header->value(0);
-    map->events_label = header->value(1);
-    map->scripts_label = header->value(2);
-    map->connections_label = header->value(3);
-    map->song = header->value(4);
-    map->layout_id = header->value(5);
-    map->location = header->value(6);
-    map->requiresFlash = header->value(7);
-    map->weather = header->value(8);
-    map->type = header->value(9);
-    map->unknown = header->value(10);
-    map->show_location = header->value(11);
-    map->battle_scene = header->value(12);
+    QList<QStringList> *commands = parseAsm(header_text);
+    QStringList header = AsmLabelIndex(commands, header_path).values(label);
+    delete commands;
+    map->layout_label = header.value(0);
+    map->events_label = header.value(1);
+    map->scripts_label = header.value(2);
+    map->connections_label = header.value(3);
+    map->song = header.value(4);
+    map->layout_id = header.value(5);
+    map->location = header.value(6);
+    map->requiresFlash = header.value(7);
+    map->weather = header.value(8);
+    map->type = header.value(9);
+    map->unknown = header.value(10);
+    map->show_location = header.value(11);
+    map->battle_scene = header.value(12);
 }
 
 void Project::setNewMapHeader(Map* map, int mapIndex) {
@@ -199,54 +234,53 @@ void Project::setNewMapHeader(Map* map, int mapIndex) {
 void Project::saveMapHeader(Map *map) {
     QString label = map->name;
     QString header_path = root + "/data/maps/" + label + "/header.inc";
-    QString text = "";
-    text += QString("%1::\n").arg(label);
-    text += QString("\t.4byte %1\n").arg(map->layout_label);
-    text += QString("\t.4byte %1\n").arg(map->events_label);
-    text += QString("\t.4byte %1\n").arg(map->scripts_label);
 
     if (map->connections.length() == 0) {
         map->connections_label = "0x0";
     } else {
         map->connections_label = QString("%1_MapConnections").arg(map->name);
     }
-    text += QString("\t.4byte %1\n").arg(map->connections_label);
 
-    text += QString("\t.2byte %1\n").arg(map->song);
-    text += QString("\t.2byte %1\n").arg(map->layout_id);
-    text += QString("\t.byte %1\n").arg(map->location);
-    text += QString("\t.byte %1\n").arg(map->requiresFlash);
-    text += QString("\t.byte %1\n").arg(map->weather);
-    text += QString("\t.byte %1\n").arg(map->type);
-    text += QString("\t.2byte %1\n").arg(map->unknown);
-    text += QString("\t.byte %1\n").arg(map->show_location);
-    text += QString("\t.byte %1\n").arg(map->battle_scene);
-    saveTextFile(header_path, text);
+    TextWriter writer(512);
+    writer.label(label);
+    writer << "\t.4byte " << map->layout_label << "\n";
+    writer << "\t.4byte " << map->events_label << "\n";
+    writer << "\t.4byte " << map->scripts_label << "\n";
+    writer << "\t.4byte " << map->connections_label << "\n";
+    writer << "\t.2byte " << map->song << "\n";
+    writer << "\t.2byte " << map->layout_id << "\n";
+    writer << "\t.byte " << map->location << "\n";
+    writer << "\t.byte " << map->requiresFlash << "\n";
+    writer << "\t.byte " << map->weather << "\n";
+    writer << "\t.byte " << map->type << "\n";
+    writer << "\t.2byte " << map->unknown << "\n";
+    writer << "\t.byte " << map->show_location << "\n";
+    writer << "\t.byte " << map->battle_scene << "\n";
+    writeFileIfChanged(header_path, writer.data);
 }
 
 void Project::saveMapConnections(Map *map) {
     QString path = root + "/data/maps/" + map->name + "/connections.inc";
     if (map->connections.length() > 0) {
-        QString text = "";
+        TextWriter writer(256 + map->connections.length() * 64);
         QString connectionsListLabel = QString("%1_MapConnectionsList").arg(map->name);
         int numValidConnections = 0;
-        text += QString("%1::\n").arg(connectionsListLabel);
+        writer.label(connectionsListLabel);
         for (Connection* connection : map->connections) {
             if (mapNamesToMapConstants->contains(connection->map_name)) {
-                text += QString("\tconnection %1, %2, %3\n")
-                        .arg(connection->direction)
-                        .arg(connection->offset)
-                        .arg(mapNamesToMapConstants->value(connection->map_name));
+                writer << "\tconnection " << connection->direction
+                       << ", " << connection->offset
+                       << ", " << mapNamesToMapConstants->value(connection->map_name) << "\n";
                 numValidConnections++;
             } else {
                 qDebug() << QString("Failed to write map connection. %1 not a valid map name").arg(connection->map_name);
             }
         }
-        text += QString("\n");
-        text += QString("%1::\n").arg(map->connections_label);
-        text += QString("\t.4byte %1\n").arg(numValidConnections);
-        text += QString("\t.4byte %1\n").arg(connectionsListLabel);
-        saveTextFile(path, text);
+        writer << "\n";
+        writer.label(map->connections_label);
+        writer << "\t.4byte " << numValidConnections << "\n";
+        writer << "\t.4byte " << connectionsListLabel << "\n";
+        writeFileIfChanged(path, writer.data);
     } else {
         deleteFile(path);
     }
@@ -268,8 +302,10 @@ void Project::updateMapsWithConnections(Map *map) {
 
 void Project::readMapLayoutsTable() {
     int curIndex = 1;
-    QString layoutsText = readTextFile(getMapLayoutsTableFilepath());
-    QList<QStringList>* values = parseAsm(layoutsText);
+    QList<QStringList>* values = readAsmFile(getMapLayoutsTableFilepath());
+    if (values == NULL) {
+        return;
+    }
     bool inLayoutPointers = false;
     for (int i = 0; i < values->length(); i++) {
         QStringList params = values->value(i);
@@ -293,13 +329,13 @@ void Project::readMapLayoutsTable() {
 }
 
 void Project::saveMapLayoutsTable() {
-    QString text = "";
-    text += QString("\t.align 2\n");
-    text += QString("gMapLayouts::\n");
+    TextWriter writer(64 + mapLayoutsTableMaster.length() * 48);
+    writer << "\t.align 2\n";
+    writer.label("gMapLayouts");
     for (QString layoutName : mapLayoutsTableMaster) {
-        text += QString("\t.4byte %1\n").arg(layoutName);
+        writer << "\t.4byte " << layoutName << "\n";
     }
-    saveTextFile(getMapLayoutsTableFilepath(), text);
+    writeFileIfChanged(getMapLayoutsTableFilepath(), writer.data);
 }
 
 QString Project::getMapLayoutsTableFilepath() {
@@ -307,25 +343,27 @@ QString Project::getMapLayoutsTableFilepath() {
 }
 
 QStringList* Project::readLayoutValues(QString layoutLabel) {
-    ParseUtil *parser = new ParseUtil;
-
-    QString layoutText = readTextFile(getMapLayoutFilepath(layoutLabel));
-    if (layoutText.isNull()) {
+    // The layout, border and blockdata labels all live in the same file, so it only needs to be parsed once.
+    QList<QStringList> *commands = readAsmFile(getMapLayoutFilepath(layoutLabel));
+    if (commands == NULL) {
         return NULL;
     }
-
-    QStringList *layoutValues = getLabelValues(parser->parseAsm(layoutText), layoutLabel);
+    QStringList *layoutValues = getLabelValues(commands, layoutLabel);
     QString borderLabel = layoutValues->value(2);
     QString blockdataLabel = layoutValues->value(3);
-    QStringList *borderValues = getLabelValues(parser->parseAsm(layoutText), borderLabel);
+    QStringList *borderValues = getLabelValues(commands, borderLabel);
     QString borderPath = borderValues->value(0).replace("\"", "");
     layoutValues->append(borderPath);
-    QStringList *blockdataValues = getLabelValues(parser->parseAsm(layoutText), blockdataLabel);
+    QStringList *blockdataValues = getLabelValues(commands, blockdataLabel);
     QString blockdataPath = blockdataValues->value(0).replace("\"", "");
     layoutValues->append(blockdataPath);
+    delete borderValues;
+    delete blockdataValues;
+    delete commands;
 
     if (layoutValues->size() != 8) {
         qDebug() << "Error: Unexpected number of properties in layout '" << layoutLabel << "'";
+        delete layoutValues;
         return NULL;
     }
 
@@ -337,29 +375,11 @@ void Project::readMapLayout(Map* map) {
         return;
     }
 
-    MapLayout *layout;
-    if (!mapLayouts.contains(map->layout_label)) {
-        QStringList *layoutValues = readLayoutValues(map->layout->label);
-        if (layoutValues == NULL) {
-            return;
-        }
-
-        layout = new MapLayout();
-        mapLayouts.insert(map->layout_label, layout);
-        layout->name = MapLayout::getNameFromLabel(map->layout_label);
-        layout->label = map->layout_label;
-        layout->width = layoutValues->value(0);
-        layout->height = layoutValues->value(1);
-        layout->border_label = layoutValues->value(2);
-        layout->blockdata_label = layoutValues->value(3);
-        layout->tileset_primary_label = layoutValues->value(4);
-        layout->tileset_secondary_label = layoutValues->value(5);
-        layout->border_path = layoutValues->value(6);
-        layout->blockdata_path = layoutValues->value(7);
-        map->layout = layout;
-    } else {
-        map->layout = mapLayouts[map->layout_label];
+    MapLayout *layout = getMapLayout(map->layout_label);
+    if (layout == NULL) {
+        return;
     }
+    map->layout = layout;
 
     loadMapTilesets(map);
     loadBlockdata(map);
@@ -369,25 +389,14 @@ void Project::readMapLayout(Map* map) {
 void Project::readAllMapLayouts() {
     mapLayouts.clear();
 
+    // Only register the layouts here. Each layout.inc is read the first time
+    // a map using the layout is opened or saved (see getMapLayout).
     for (int i = 0; i < mapLayoutsTable.size(); i++) {
         QString layoutLabel = mapLayoutsTable[i];
-        QStringList *layoutValues = readLayoutValues(layoutLabel);
-        if (layoutValues == NULL) {
-            return;
-        }
-
         MapLayout *layout = new MapLayout();
         layout->name = MapLayout::getNameFromLabel(layoutLabel);
         layout->label = layoutLabel;
         layout->index = i;
-        layout->width = layoutValues->value(0);
-        layout->height = layoutValues->value(1);
-        layout->border_label = layoutValues->value(2);
-        layout->blockdata_label = layoutValues->value(3);
-        layout->tileset_primary_label = layoutValues->value(4);
-        layout->tileset_secondary_label = layoutValues->value(5);
-        layout->border_path = layoutValues->value(6);
-        layout->blockdata_path = layoutValues->value(7);
         mapLayouts.insert(layoutLabel, layout);
     }
 
@@ -396,25 +405,222 @@ void Project::readAllMapLayouts() {
     mapLayoutsMaster.detach();
 }
 
+MapLayout* Project::getMapLayout(QString layoutLabel) {
+    MapLayout *layout = mapLayouts.value(layoutLabel, NULL);
+    if (layout == NULL) {
+        layout = new MapLayout();
+        layout->name = MapLayout::getNameFromLabel(layoutLabel);
+        layout->label = layoutLabel;
+        layout->index = mapLayoutsTable.indexOf(layoutLabel);
+        mapLayouts.insert(layoutLabel, layout);
+    }
+    if (!layout->loaded && !loadMapLayout(layout)) {
+        return NULL;
+    }
+    return layout;
+}
+
+bool Project::loadMapLayout(MapLayout *layout) {
+    TRACE_ZONE("Project::loadMapLayout", "project");
+    if (readLayoutDocument(layout)) {
+        layout->loaded = true;
+        return true;
+    }
+
+    QStringList *layoutValues = NULL;
+    layoutPrefetchMutex.lock();
+    if (prefetchedLayoutValues.contains(layout->label)) {
+        layoutValues = new QStringList(prefetchedLayoutValues.take(layout->label));
+    }
+    layoutPrefetchMutex.unlock();
+
+    if (layoutValues == NULL) {
+        layoutValues = readLayoutValues(layout->label);
+        if (layoutValues == NULL) {
+            return false;
+        }
+    }
+
+    layout->width = layoutValues->value(0);
+    layout->height = layoutValues->value(1);
+    layout->border_label = layoutValues->value(2);
+    layout->blockdata_label = layoutValues->value(3);
+    layout->tileset_primary_label = layoutValues->value(4);
+    layout->tileset_secondary_label = layoutValues->value(5);
+    layout->border_path = layoutValues->value(6);
+    layout->blockdata_path = layoutValues->value(7);
+    layout->loaded = true;
+    delete layoutValues;
+    return true;
+}
+
+QStringList Project::getAdjacentMapNames(QString mapName) {
+    QStringList allMapNames;
+    for (QStringList names : groupedMapNames) {
+        allMapNames.append(names);
+    }
+    QStringList adjacent;
+    int index = allMapNames.indexOf(mapName);
+    if (index < 0) {
+        return adjacent;
+    }
+    if (index > 0) {
+        adjacent.append(allMapNames.value(index - 1));
+    }
+    if (index + 1 < allMapNames.length()) {
+        adjacent.append(allMapNames.value(index + 1));
+    }
+    return adjacent;
+}
+
+// The maps reachable from a map through its connections and warps, nearest first.
+QStringList Project::getLinkedMapNames(Map *map) {
+    QStringList linked;
+    QStringList candidates;
+    for (Connection *connection : map->connections) {
+        candidates.append(connection->map_name);
+    }
+    for (Event *warp : map->events.value("warp_event_group")) {
+        candidates.append(warp->get("destination_map_name"));
+    }
+    for (QString mapName : candidates) {
+        if (mapName != map->name && mapNames->contains(mapName) && !linked.contains(mapName)) {
+            linked.append(mapName);
+        }
+    }
+    return linked;
+}
+
+void Project::prefetchMapLayouts(QStringList mapNames) {
+    TRACE_ZONE("Project::prefetchMapLayouts", "project");
+    // Layout documents are cheap enough to read on demand.
+    if (!prefetch_layouts || map_format != MapFormat::Asm) {
+        return;
+    }
+
+    // Opened maps have already resolved their layouts.
+    QStringList pendingMapNames;
+    for (QString mapName : mapNames) {
+        if (!map_cache->contains(mapName)) {
+            pendingMapNames.append(mapName);
+        }
+    }
+    if (pendingMapNames.isEmpty()) {
+        return;
+    }
+
+    QStringList loadedLayoutLabels;
+    for (MapLayout *layout : mapLayouts.values()) {
+        if (layout->loaded) {
+            loadedLayoutLabels.append(layout->label);
+        }
+    }
+
+    for (int i = layoutPrefetches.length() - 1; i >= 0; i--) {
+        if (layoutPrefetches.at(i).isFinished()) {
+            layoutPrefetches.removeAt(i);
+        }
+    }
+
+    // Only the file reads and parsing happen off the main thread.
+    // The results are picked up by loadMapLayout() when the map is opened.
+    layoutPrefetches.append(QtConcurrent::run([this, pendingMapNames, loadedLayoutLabels]() {
+        for (QString mapName : pendingMapNames) {
+            if (layoutPrefetchesCancelled.loadAcquire()) {
+                return;
+            }
+            QString layoutLabel = readMapLayoutLabel(mapName);
+            if (layoutLabel.isEmpty() || loadedLayoutLabels.contains(layoutLabel)) {
+                continue;
+            }
+
+            layoutPrefetchMutex.lock();
+            bool alreadyPrefetched = prefetchedLayoutValues.contains(layoutLabel);
+            layoutPrefetchMutex.unlock();
+            if (alreadyPrefetched) {
+                continue;
+            }
+
+            QStringList *layoutValues = readLayoutValues(layoutLabel);
+            if (layoutValues == NULL) {
+                continue;
+            }
+            layoutPrefetchMutex.lock();
+            prefetchedLayoutValues.insert(layoutLabel, *layoutValues);
+            layoutPrefetchMutex.unlock();
+            delete layoutValues;
+        }
+    }));
+}
+
+// Stops the layout prefetches that are still running, and waits for them, since they use the project.
+// Call this before the project goes away.
+// Reads the label of a map's layout from its header. Safe to call from other threads.
+QString Project::readMapLayoutLabel(QString mapName) {
+    QString headerText = readTextFile(root + "/data/maps/" + mapName + "/header.inc");
+    if (headerText.isNull()) {
+        return QString();
+    }
+    QList<QStringList> *commands = parseAsm(headerText);
+    QStringList *header = getLabelValues(commands, mapName);
+    QString layoutLabel = header->value(0);
+    delete header;
+    delete commands;
+    return layoutLabel;
+}
+
+// The labels of the tilesets a map uses, read from its header and layout. Safe to call from other threads.
+// Maps stored in documents aren't looked up here; their tilesets are read when they're loaded.
+QStringList Project::readMapTilesetLabels(QString mapName) {
+    QStringList labels;
+    if (map_format != MapFormat::Asm) {
+        return labels;
+    }
+    QString layoutLabel = readMapLayoutLabel(mapName);
+    if (layoutLabel.isEmpty()) {
+        return labels;
+    }
+    QStringList *layoutValues = readLayoutValues(layoutLabel);
+    if (layoutValues == NULL) {
+        return labels;
+    }
+    labels << layoutValues->value(4) << layoutValues->value(5);
+    delete layoutValues;
+    return labels;
+}
+
+void Project::cancelPrefetches() {
+    layoutPrefetchesCancelled.storeRelease(1);
+    for (QFuture<void> future : layoutPrefetches) {
+        future.waitForFinished();
+    }
+    layoutPrefetches.clear();
+}
+
 void Project::saveAllMapLayouts() {
     for (QString layoutName : mapLayoutsTableMaster) {
         MapLayout *layout = mapLayouts.value(layoutName);
-        QString text = QString("%1::\n").arg(layout->border_label);
-        text += QString("\t.incbin \"%1\"\n").arg(layout->border_path);
-        text += QString("\n");
-        text += QString("%1::\n").arg(layout->blockdata_label);
-        text += QString("\t.incbin \"%1\"\n").arg(layout->blockdata_path);
-        text += QString("\n");
-        text += QString("\t.align 2\n");
-        text += QString("%1::\n").arg(layoutName);
-        text += QString("\t.4byte %1\n").arg(layout->width);
-        text += QString("\t.4byte %1\n").arg(layout->height);
-        text += QString("\t.4byte %1\n").arg(layout->border_label);
-        text += QString("\t.4byte %1\n").arg(layout->blockdata_label);
-        text += QString("\t.4byte %1\n").arg(layout->tileset_primary_label);
-        text += QString("\t.4byte %1\n").arg(layout->tileset_secondary_label);
-        text += QString("\n");
-        saveTextFile(getMapLayoutFilepath(layout->label), text);
+        if (!layout || !layout->loaded) {
+            // Layouts that were never resolved can't have changed since they were read.
+            continue;
+        }
+        TextWriter writer(512);
+        writer.label(layout->border_label);
+        writer << "\t.incbin \"" << layout->border_path << "\"\n";
+        writer << "\n";
+        writer.label(layout->blockdata_label);
+        writer << "\t.incbin \"" << layout->blockdata_path << "\"\n";
+        writer << "\n";
+        writer << "\t.align 2\n";
+        writer.label(layoutName);
+        writer << "\t.4byte " << layout->width << "\n";
+        writer << "\t.4byte " << layout->height << "\n";
+        writer << "\t.4byte " << layout->border_label << "\n";
+        writer << "\t.4byte " << layout->blockdata_label << "\n";
+        writer << "\t.4byte " << layout->tileset_primary_label << "\n";
+        writer << "\t.4byte " << layout->tileset_secondary_label << "\n";
+        writer << "\n";
+        writeFileIfChanged(getMapLayoutFilepath(layout->label), writer.data);
     }
 }
 
@@ -434,6 +640,7 @@ void Project::setNewMapLayout(Map* map) {
     layout->blockdata_path = QString("data/layouts/%1/map.bin").arg(map->name);
     layout->tileset_primary_label = "gTileset_General";
     layout->tileset_secondary_label = "gTileset_Petalburg";
+    layout->loaded = true;
     map->layout = layout;
     map->layout_label = layout->label;
 
@@ -443,35 +650,36 @@ void Project::setNewMapLayout(Map* map) {
 }
 
 void Project::saveMapGroupsTable() {
-    QString text = "";
+    TextWriter writer(64 * 1024);
     int groupNum = 0;
     for (QStringList mapNames : groupedMapNames) {
-        text += QString("\t.align 2\n");
-        text += QString("gMapGroup%1::\n").arg(groupNum);
+        writer << "\t.align 2\n";
+        writer << "gMapGroup" << groupNum << "::\n";
         for (QString mapName : mapNames) {
-            text += QString("\t.4byte %1\n").arg(mapName);
+            writer << "\t.4byte " << mapName << "\n";
         }
-        text += QString("\n");
+        writer << "\n";
         groupNum++;
     }
 
-    text += QString("\t.align 2\n");
-    text += QString("gMapGroups::\n");
+    writer << "\t.align 2\n";
+    writer.label("gMapGroups");
     for (int i = 0; i < groupNum; i++) {
-        text += QString("\t.4byte gMapGroup%1\n").arg(i);
+        writer << "\t.4byte gMapGroup" << i << "\n";
     }
 
-    saveTextFile(root + "/data/maps/groups.inc", text);
+    writeFileIfChanged(root + "/data/maps/groups.inc", writer.data);
 }
 
 void Project::saveMapConstantsHeader() {
-    QString text = QString("#ifndef GUARD_CONSTANTS_MAPS_H\n");
-    text += QString("#define GUARD_CONSTANTS_MAPS_H\n");
-    text += QString("\n");
+    TextWriter writer(64 * 1024);
+    writer << "#ifndef GUARD_CONSTANTS_MAPS_H\n";
+    writer << "#define GUARD_CONSTANTS_MAPS_H\n";
+    writer << "\n";
 
     int groupNum = 0;
     for (QStringList mapNames : groupedMapNames) {
-        text += QString("// Map Group %1\n").arg(groupNum);
+        writer << "// Map Group " << groupNum << "\n";
         int maxLength = 0;
         for (QString mapName : mapNames) {
             QString mapConstantName = mapNamesToMapConstants->value(mapName);
@@ -481,27 +689,26 @@ void Project::saveMapConstantsHeader() {
         int groupIndex = 0;
         for (QString mapName : mapNames) {
             QString mapConstantName = mapNamesToMapConstants->value(mapName);
-            text += QString("#define %1%2(%3 | (%4 << 8))\n")
-                    .arg(mapConstantName)
-                    .arg(QString(" ").repeated(maxLength - mapConstantName.length() + 1))
-                    .arg(groupIndex)
-                    .arg(groupNum);
+            writer << "#define " << mapConstantName;
+            writer.fill(' ', maxLength - mapConstantName.length() + 1);
+            writer << "(" << groupIndex << " | (" << groupNum << " << 8))\n";
             groupIndex++;
         }
-        text += QString("\n");
+        writer << "\n";
         groupNum++;
     }
 
-    text += QString("\n");
-    text += QString("#define MAP_NONE (0x7F | (0x7F << 8))\n");
-    text += QString("#define MAP_UNDEFINED (0xFF | (0xFF << 8))\n\n\n");
-    text += QString("#define MAP_GROUP(map) (MAP_##map >> 8)\n");
-    text += QString("#define MAP_NUM(map) (MAP_##map & 0xFF)\n\n");
-    text += QString("#endif  // GUARD_CONSTANTS_MAPS_H\n");
-    saveTextFile(root + "/include/constants/maps.h", text);
+    writer << "\n";
+    writer << "#define MAP_NONE (0x7F | (0x7F << 8))\n";
+    writer << "#define MAP_UNDEFINED (0xFF | (0xFF << 8))\n\n\n";
+    writer << "#define MAP_GROUP(map) (MAP_##map >> 8)\n";
+    writer << "#define MAP_NUM(map) (MAP_##map & 0xFF)\n\n";
+    writer << "#endif  // GUARD_CONSTANTS_MAPS_H\n";
+    writeFileIfChanged(root + "/include/constants/maps.h", writer.data);
 }
 
 void Project::loadMapTilesets(Map* map) {
+    TRACE_ZONE("Project::loadMapTilesets", "project");
     if (map->layout->has_unsaved_changes) {
         return;
     }
@@ -511,10 +718,38 @@ void Project::loadMapTilesets(Map* map) {
 }
 
 Tileset* Project::loadTileset(QString label) {
-    ParseUtil *parser = new ParseUtil;
+    return cacheTileset(label, readTileset(label));
+}
 
-    QString headers_text = readTextFile(root + "/data/tilesets/headers.inc");
-    QStringList *values = getLabelValues(parser->parseAsm(headers_text), label);
+// Deletes a tileset from readTileset(), and takes its data out of the asset pool's counts.
+void Project::deleteTileset(Tileset *tileset) {
+    assets->release(tileset);
+    delete tileset;
+}
+
+// Adds a tileset from readTileset() to the cache. If one was loaded for the label in the meantime,
+// that one is kept and the new one is deleted.
+Tileset* Project::cacheTileset(QString label, Tileset *tileset) {
+    if (tileset_cache->contains(label)) {
+        deleteTileset(tileset);
+        return tileset_cache->value(label);
+    }
+    tileset_cache->insert(label, tileset);
+    if (watcher) {
+        watcher->watchTileset(tileset, label);
+    }
+    return tileset;
+}
+
+// Reads a tileset without adding it to the cache. Safe to call from other threads.
+Tileset* Project::readTileset(QString label) {
+    TRACE_ZONE("Project::readTileset", "project");
+    QList<QStringList> *headers = readAsmFile(root + "/data/tilesets/headers.inc");
+    if (headers == NULL) {
+        headers = new QList<QStringList>;
+    }
+    QStringList *values = getLabelValues(headers, label);
+    delete headers;
     Tileset *tileset = new Tileset;
     tileset->name = label;
     tileset->is_compressed = values->value(0);
@@ -525,13 +760,52 @@ Tileset* Project::loadTileset(QString label) {
     tileset->metatiles_label = values->value(5);
     tileset->metatile_attrs_label = values->value(6);
     tileset->callback_label = values->value(7);
+    delete values;
 
     loadTilesetAssets(tileset);
-
-    tileset_cache->insert(label, tileset);
     return tileset;
 }
 
+// Swaps reread tilesets in for the cached ones, and deletes the old ones. Anything else
+// that holds on to tilesets (like a world map) must have stopped using them first.
+// Returns the tilesets that were replaced, and what they were replaced with.
+QMap<Tileset*, Tileset*> Project::replaceTilesets(QMap<QString, Tileset*> tilesets) {
+    QMap<Tileset*, Tileset*> replaced;
+    for (QString label : tilesets.keys()) {
+        Tileset *old_tileset = tileset_cache->value(label);
+        Tileset *tileset = tilesets.value(label);
+        tileset_cache->insert(label, tileset);
+        for (MapLayout *layout : mapLayouts.values()) {
+            if (layout->tileset_primary == old_tileset) {
+                layout->tileset_primary = tileset;
+            }
+            if (layout->tileset_secondary == old_tileset) {
+                layout->tileset_secondary = tileset;
+            }
+        }
+        if (watcher) {
+            watcher->watchTileset(tileset, label);
+        }
+        if (old_tileset && old_tileset != tileset) {
+            replaced.insert(old_tileset, tileset);
+        }
+    }
+
+    // Renders are matched to their tilesets by pointer, which a new tileset could reuse.
+    for (Map *map : map_cache->values()) {
+        if (replaced.contains(map->image_tilesets.first) || replaced.contains(map->image_tilesets.second)) {
+            map->image_tilesets = QPair<Tileset*, Tileset*>();
+        }
+        if (replaced.contains(map->collision_image_tilesets.first) || replaced.contains(map->collision_image_tilesets.second)) {
+            map->collision_image_tilesets = QPair<Tileset*, Tileset*>();
+        }
+    }
+    for (Tileset *old_tileset : replaced.keys()) {
+        deleteTileset(old_tileset);
+    }
+    return replaced;
+}
+
 void Project::loadBlockdata(Map* map) {
     if (!map->isPersistedToFile || map->layout->has_unsaved_changes) {
         return;
@@ -575,41 +849,32 @@ void Project::saveMapBorder(Map *map) {
 void Project::saveBlockdata(Map* map) {
     QString path = QString("%1/%2").arg(root).arg(map->layout->blockdata_path);
     writeBlockdata(path, map->layout->blockdata);
-    map->history.save();
 }
 
 void Project::writeBlockdata(QString path, Blockdata *blockdata) {
-    QFile file(path);
-    if (file.open(QIODevice::WriteOnly)) {
-        QByteArray data = blockdata->serialize();
-        file.write(data);
-    } else {
-        qDebug() << "Failed to open blockdata file for writing: '" << path << "'";
-    }
+    writeFileIfChanged(path, blockdata->serialize());
 }
 
-void Project::saveAllMaps() {
+// Maps without unsaved changes are skipped, since regenerating their files would
+// only reproduce what's already on disk.
+void Project::saveAllMaps(bool include_unchanged) {
+    TRACE_ZONE("Project::saveAllMaps", "save");
     QList<QString> keys = map_cache->keys();
     for (int i = 0; i < keys.length(); i++) {
         QString key = keys.value(i);
         Map* map = map_cache->value(key);
+        if (!include_unchanged && !map->hasUnsavedChanges()) {
+            continue;
+        }
         saveMap(map);
     }
 }
 
 void Project::saveMap(Map *map) {
+    TRACE_ZONE("Project::saveMap", "save");
     // Create/Modify a few collateral files for brand new maps.
-    if (!map->isPersistedToFile) {
-        QString newMapDataDir = QString(root + "/data/maps/%1").arg(map->name);
-        if (!QDir::root().mkdir(newMapDataDir)) {
-            qDebug() << "Error: failed to create directory for new map. " << newMapDataDir;
-        }
-
-        QString newLayoutDir = QString(root + "/data/layouts/%1").arg(map->name);
-        if (!QDir::root().mkdir(newLayoutDir)) {
-            qDebug() << "Error: failed to create directory for new layout. " << newLayoutDir;
-        }
-
+    // Their directories are created when the files are written.
+    if (!map->isPersistedToFile && !savedMapNames.contains(map->name)) {
         // TODO: In the future, these files needs more structure to allow for proper parsing/saving.
         // Create file data/maps/<map_name>/scripts.inc
         QString text = QString("%1_MapScripts::\n\t.byte 0\n").arg(map->name);
@@ -641,12 +906,27 @@ void Project::saveMap(Map *map) {
     saveMapConnections(map);
     saveBlockdata(map);
     saveMapEvents(map);
+    if (map_format != MapFormat::Asm) {
+        saveMapDocument(map, map_format);
+    }
 
     // Update global data structures with current map data.
     updateMapLayout(map);
 
+    // A staged map only counts as saved once the whole save is committed.
+    if (!saveTransaction) {
+        markMapSaved(map);
+    } else if (!savedMapNames.contains(map->name)) {
+        savedMapNames.append(map->name);
+    }
+}
+
+void Project::markMapSaved(Map *map) {
     map->isPersistedToFile = true;
+    map->has_unsaved_changes = false;
     map->layout->has_unsaved_changes = false;
+    map->history.save();
+    map->saved_event_revisions = map->getEventRevisions();
 }
 
 void Project::updateMapLayout(Map* map) {
@@ -662,6 +942,7 @@ void Project::updateMapLayout(Map* map) {
 }
 
 void Project::saveAllDataStructures() {
+    TRACE_ZONE("Project::saveAllDataStructures", "save");
     saveMapLayoutsTable();
     saveAllMapLayouts();
     saveMapGroupsTable();
@@ -670,15 +951,17 @@ void Project::saveAllDataStructures() {
 }
 
 void Project::loadTilesetAssets(Tileset* tileset) {
-    ParseUtil* parser = new ParseUtil;
+    TRACE_ZONE("Project::loadTilesetAssets", "project");
     QString category = (tileset->is_secondary == "TRUE") ? "secondary" : "primary";
     if (tileset->name.isNull()) {
         return;
     }
     QString dir_path = root + "/data/tilesets/" + category + "/" + tileset->name.replace("gTileset_", "").toLower();
 
-    QString graphics_text = readTextFile(root + "/data/tilesets/graphics.inc");
-    QList<QStringList> *graphics = parser->parseAsm(graphics_text);
+    QList<QStringList> *graphics = readAsmFile(root + "/data/tilesets/graphics.inc");
+    if (graphics == NULL) {
+        graphics = new QList<QStringList>;
+    }
     QStringList *tiles_values = getLabelValues(graphics, tileset->tiles_label);
     QStringList *palettes_values = getLabelValues(graphics, tileset->palettes_label);
 
@@ -707,8 +990,10 @@ void Project::loadTilesetAssets(Tileset* tileset) {
 
     QString metatiles_path;
     QString metatile_attrs_path;
-    QString metatiles_text = readTextFile(root + "/data/tilesets/metatiles.inc");
-    QList<QStringList> *metatiles_macros = parser->parseAsm(metatiles_text);
+    QList<QStringList> *metatiles_macros = readAsmFile(root + "/data/tilesets/metatiles.inc");
+    if (metatiles_macros == NULL) {
+        metatiles_macros = new QList<QStringList>;
+    }
     QStringList *metatiles_values = getLabelValues(metatiles_macros, tileset->metatiles_label);
     if (!metatiles_values->isEmpty()) {
         metatiles_path = root + "/" + metatiles_values->value(0).section('"', 1, 1);
@@ -723,19 +1008,10 @@ void Project::loadTilesetAssets(Tileset* tileset) {
     }
 
     // tiles
-    tiles_path = fixGraphicPath(tiles_path);
-    QImage *image = new QImage(tiles_path);
-    //image->setColor(0, qRgb(0xff, 0, 0)); // debug
-
-    QList<QImage> *tiles = new QList<QImage>;
-    int w = 8;
-    int h = 8;
-    for (int y = 0; y < image->height(); y += h)
-    for (int x = 0; x < image->width(); x += w) {
-        QImage tile = image->copy(x, y, w, h);
-        tiles->append(tile);
-    }
-    tileset->tiles = tiles;
+    tileset->tiles = assets->internTiles(readTilesetTiles(tiles_path));
+    QString raw_tiles_path = QString(tiles_path).replace(QRegExp("\\.lz$"), "");
+    tileset->sources << fixGraphicPath(tiles_path) << raw_tiles_path << raw_tiles_path + ".lz";
+    tileset->sources << metatiles_path << metatile_attrs_path;
 
     // metatiles
     QFile metatiles_file(metatiles_path);
@@ -778,13 +1054,92 @@ void Project::loadTilesetAssets(Tileset* tileset) {
     } else {
         qDebug() << QString("Could not open '%1'").arg(metatile_attrs_path);
     }
+    for (int i = 0; i < tileset->metatiles->length(); i++) {
+        (*tileset->metatiles)[i] = assets->internMetatile(tileset->metatiles->value(i));
+    }
 
     // palettes
-    QList<QList<QRgb>> *palettes = new QList<QList<QRgb>>;
+    QStringList palette_sources;
     for (int i = 0; i < palette_paths->length(); i++) {
         QString path = palette_paths->value(i);
         // the palettes are not compressed. this should never happen. it's only a precaution.
-        path = path.replace(QRegExp("\\.lz$"), "");
+        palette_sources.append(path.replace(QRegExp("\\.lz$"), ""));
+    }
+    tileset->palettes = readTilesetPalettes(palette_sources);
+    for (int i = 0; i < tileset->palettes->length(); i++) {
+        (*tileset->palettes)[i] = assets->internPalette(tileset->palettes->value(i));
+    }
+    tileset->sources << palette_sources;
+    delete palette_paths;
+}
+
+// Reads the color indices of a tileset's tiles. The .png is what the .4bpp is built
+// from, so it's read whenever it exists, and the .4bpp (or .4bpp.lz) only otherwise.
+// The project cache checks the .png by content, so it's only decoded again when it
+// actually changes (not just when a checkout touches it).
+QByteArray Project::readTilesetTiles(QString path) {
+    QString png_path = fixGraphicPath(path);
+    QString source = png_path;
+    QString raw_path = QString(path).replace(QRegExp("\\.lz$"), "");
+    if (raw_path.endsWith(".4bpp") && !QFileInfo::exists(png_path)) {
+        for (QString candidate : QStringList() << raw_path << raw_path + ".lz") {
+            if (QFileInfo::exists(candidate)) {
+                source = candidate;
+                break;
+            }
+        }
+    }
+
+    QString key = "tiles:" + source;
+    QStringList sources = QStringList() << source;
+    QByteArray tiles;
+    if (cache && cache->get(key, sources, &tiles)) {
+        return tiles;
+    }
+
+    if (source == png_path) {
+        QImage image(source);
+        if (image.isNull()) {
+            qDebug() << QString("Could not open tileset image '%1'").arg(source);
+            return tiles;
+        }
+        int invalidPixels = 0;
+        tiles = Tileset::decodeTileImage(image, &invalidPixels);
+        if (invalidPixels) {
+            qDebug() << QString("Tileset image '%1' has %2 pixels with color indices above 15. They're drawn with color 0 of their palette.").arg(source).arg(invalidPixels);
+        }
+    } else {
+        QFile file(source);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qDebug() << QString("Could not open '%1'").arg(source);
+            return tiles;
+        }
+        QByteArray data = file.readAll();
+        if (source.endsWith(".lz")) {
+            data = LZ77::decompress(data);
+        }
+        tiles = Tileset::decode4bpp(data);
+    }
+
+    if (cache) {
+        cache->put(key, sources, tiles);
+    }
+    return tiles;
+}
+
+QList<QList<QRgb>>* Project::readTilesetPalettes(QStringList paths) {
+    QList<QList<QRgb>> *palettes = new QList<QList<QRgb>>;
+    QString key = "palettes:" + paths.join(";");
+    QByteArray data;
+    if (cache && cache->get(key, paths, &data)) {
+        QDataStream in(data);
+        in.setVersion(QDataStream::Qt_5_0);
+        in >> *palettes;
+        return palettes;
+    }
+
+    for (int i = 0; i < paths.length(); i++) {
+        QString path = paths.value(i);
         // TODO default to .pal (JASC-PAL)
         // just use .gbapal for now
         QFile file(path);
@@ -809,10 +1164,19 @@ void Project::loadTilesetAssets(Tileset* tileset) {
 
         palettes->append(palette);
     }
-    tileset->palettes = palettes;
+
+    if (cache) {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << *palettes;
+        cache->put(key, paths, data);
+    }
+    return palettes;
 }
 
 Blockdata* Project::readBlockdata(QString path) {
+    TRACE_ZONE("Project::readBlockdata", "parse");
     Blockdata *blockdata = new Blockdata;
     QFile file(path);
     if (file.open(QIODevice::ReadOnly)) {
@@ -839,13 +1203,538 @@ Map* Project::getMap(QString map_name) {
 
 Tileset* Project::getTileset(QString label) {
     if (tileset_cache->contains(label)) {
+        PerfCounters::add(PerfCounters::TilesetCacheHits);
         return tileset_cache->value(label);
     } else {
+        PerfCounters::add(PerfCounters::TilesetCacheMisses);
         Tileset *tileset = loadTileset(label);
         return tileset;
     }
 }
 
+QStringList Project::getMapSourcePaths(Map *map) {
+    QStringList paths;
+    paths << root + "/data/maps/" + map->name + "/header.inc";
+    paths << root + "/data/maps/" + map->name + "/events.inc";
+    paths << root + "/data/maps/" + map->name + "/connections.inc";
+    if (map->layout) {
+        paths << getMapLayoutFilepath(map->layout->label);
+        paths << QString("%1/%2").arg(root).arg(map->layout->blockdata_path);
+        paths << QString("%1/%2").arg(root).arg(map->layout->border_path);
+    }
+    if (map_format != MapFormat::Asm) {
+        paths << MapFormat::mapPath(root, map->name, map_format);
+        if (map->layout) {
+            paths << MapFormat::layoutPath(root, map->layout->name, map_format);
+        }
+    }
+    return paths;
+}
+
+// Whether the file is exactly what pretmap last wrote to it.
+bool Project::matchesSavedFile(QString path) {
+    if (!savedFiles.contains(path)) {
+        return false;
+    }
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Md5) == savedFiles.value(path).first;
+}
+
+// Rereads a map from disk in place, so pointers to it (like the editor's) stay valid.
+// Any unsaved edits to the map are lost. Its events are replaced, so the editor has to
+// redisplay them.
+void Project::reloadMap(Map *map) {
+    MapLayout *layout = map->layout;
+    Blockdata *old_blockdata = layout ? layout->blockdata : NULL;
+    Blockdata *old_border = layout ? layout->border : NULL;
+    if (layout) {
+        layoutPrefetchMutex.lock();
+        prefetchedLayoutValues.remove(layout->label);
+        layoutPrefetchMutex.unlock();
+        layout->loaded = false;
+        layout->has_unsaved_changes = false;
+    }
+    // Reading the map deletes its old events and connections.
+    readMap(map);
+
+    // Other maps with the same layout were reread along with it.
+    QList<Map*> maps;
+    maps.append(map);
+    for (Map *other : map_cache->values()) {
+        if (other != map && other->layout && other->layout == map->layout) {
+            maps.append(other);
+        }
+    }
+    for (Map *reloaded : maps) {
+        reloaded->clearHistory();
+        reloaded->commit();
+        reloaded->history.save();
+        if (reloaded == map) {
+            reloaded->saved_event_revisions = reloaded->getEventRevisions();
+        }
+        updateJournalSnapshot(reloaded);
+    }
+    if (layout && layout->blockdata != old_blockdata) {
+        delete old_blockdata;
+    }
+    if (layout && layout->border != old_border) {
+        delete old_border;
+    }
+    if (watcher) {
+        watcher->watchMap(map);
+    }
+}
+
+// Reads the map from its document if that's the authoritative format. Returns false
+// if the map should be read from asm instead.
+bool Project::readMapDocument(Map *map) {
+    if (map_format == MapFormat::Asm || !map->isPersistedToFile) {
+        return false;
+    }
+    QString path = MapFormat::mapPath(root, map->name, map_format);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QVariantMap document;
+    if (!MapFormat::read(file.readAll(), map_format, &document) || !MapFormat::toMap(document, map)) {
+        qDebug() << QString("Failed to read map document '%1'. Falling back to asm.").arg(path);
+        return false;
+    }
+    readMapLayout(map);
+    return true;
+}
+
+bool Project::readLayoutDocument(MapLayout *layout) {
+    if (map_format == MapFormat::Asm) {
+        return false;
+    }
+    QString path = MapFormat::layoutPath(root, layout->name, map_format);
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QVariantMap document;
+    if (!MapFormat::read(file.readAll(), map_format, &document) || !MapFormat::toLayout(document, layout)) {
+        qDebug() << QString("Failed to read layout document '%1'. Falling back to asm.").arg(path);
+        return false;
+    }
+    return true;
+}
+
+void Project::saveMapDocument(Map *map, MapFormat::Format format) {
+    writeFileIfChanged(MapFormat::mapPath(root, map->name, format), MapFormat::write(MapFormat::fromMap(map), format));
+    if (map->layout) {
+        writeFileIfChanged(MapFormat::layoutPath(root, map->layout->name, format), MapFormat::write(MapFormat::fromLayout(map->layout), format));
+    }
+}
+
+// Writes every map and layout in the given format. Maps that aren't open yet are loaded to do so.
+bool Project::exportMaps(MapFormat::Format format, std::function<void(int, int)> progress) {
+    if (format == MapFormat::Asm) {
+        return true;
+    }
+    beginSave();
+    for (QString map_name : *mapNames) {
+        Map *map = getMap(map_name);
+        if (map) {
+            saveMapDocument(map, format);
+        }
+    }
+    return commitSave(progress);
+}
+
+// Reads every map that has a document in the given format, and regenerates its asm.
+// Open maps are reread, so their unsaved edits are lost.
+bool Project::importMaps(MapFormat::Format format, std::function<void(int, int)> progress) {
+    if (format == MapFormat::Asm) {
+        return true;
+    }
+
+    QList<Map*> maps;
+    MapFormat::Format authoritative_format = map_format;
+    map_format = format;
+    for (QString map_name : *mapNames) {
+        if (!QFile::exists(MapFormat::mapPath(root, map_name, format))) {
+            continue;
+        }
+        Map *map = map_cache->value(map_name);
+        if (map) {
+            reloadMap(map);
+        } else {
+            map = loadMap(map_name);
+        }
+        if (map) {
+            maps.append(map);
+        }
+    }
+    map_format = authoritative_format;
+
+    beginSave();
+    for (Map *map : maps) {
+        saveMap(map);
+    }
+    saveAllDataStructures();
+    return commitSave(progress);
+}
+
+void Project::startJournal() {
+    if (!journal) {
+        journal = new Journal(Journal::pathForProject(root));
+        journal->start(QThread::LowPriority);
+    }
+}
+
+void Project::stopJournal() {
+    if (journal) {
+        journalFuture.waitForFinished();
+        journalChanges();
+        journalFuture.waitForFinished();
+        // Waits for the journal to write out everything that's queued.
+        delete journal;
+        journal = NULL;
+    }
+}
+
+// Queues the edits made to each open map since it was last journaled. Only maps whose
+// history or events changed are copied here. Comparing them with what was journaled
+// before happens on a worker, and the journal writes the records out on its own thread.
+void Project::journalChanges() {
+    if (!journal || journalFuture.isRunning()) {
+        return;
+    }
+
+    QList<JournalSnapshot> snapshots;
+    for (Map *map : map_cache->values()) {
+        if (!map->layout || !map->layout->blockdata) {
+            continue;
+        }
+        if (!journaledHistory.contains(map->name)) {
+            updateJournalSnapshot(map);
+            continue;
+        }
+
+        JournalSnapshot snapshot;
+        snapshot.map_name = map->name;
+        if (map->history.getRevision() != journaledHistory.value(map->name)) {
+            snapshot.has_blocks = true;
+            snapshot.blocks = map->layout->blockdata->serialize();
+            snapshot.dimensions = QSize(map->getWidth(), map->getHeight());
+            journaledHistory.insert(map->name, map->history.getRevision());
+        }
+        QList<quint64> revisions = map->getEventRevisions();
+        if (revisions != journaledEventRevisions.value(map->name)) {
+            snapshot.has_events = true;
+            snapshot.events = serializeJournalEvents(map);
+            journaledEventRevisions.insert(map->name, revisions);
+        }
+        if (!journalBases.contains(map->name)) {
+            snapshot.source_paths = getMapSourcePaths(map);
+        }
+        if (snapshot.has_blocks || snapshot.has_events || !snapshot.source_paths.isEmpty()) {
+            snapshots.append(snapshot);
+        }
+    }
+
+    if (!snapshots.isEmpty()) {
+        journalFuture = QtConcurrent::run([this, snapshots]() {
+            diffJournalSnapshots(snapshots);
+        });
+    }
+}
+
+void Project::diffJournalSnapshots(QList<JournalSnapshot> snapshots) {
+    for (JournalSnapshot snapshot : snapshots) {
+        if (!snapshot.source_paths.isEmpty()) {
+            journalBases.insert(snapshot.map_name, hashMapSources(snapshot.source_paths));
+        }
+
+        if (snapshot.has_blocks) {
+            QByteArray blocks = snapshot.blocks;
+            QByteArray old_blocks = journaledBlockdata.value(snapshot.map_name);
+            QSize dimensions = snapshot.dimensions;
+            bool resized = dimensions != journaledDimensions.value(snapshot.map_name) || blocks.length() != old_blocks.length();
+            if (resized || blocks != old_blocks) {
+                // Only the blocks that changed are recorded, unless the map was resized.
+                QList<QPair<quint32, quint16>> changes;
+                for (int i = 0; i + 1 < blocks.length(); i += 2) {
+                    if (resized || blocks.at(i) != old_blocks.at(i) || blocks.at(i + 1) != old_blocks.at(i + 1)) {
+                        quint16 word = uchar(blocks.at(i)) | (uchar(blocks.at(i + 1)) << 8);
+                        changes.append(QPair<quint32, quint16>(i / 2, word));
+                    }
+                }
+                Journal::Record record;
+                record.type = Journal::Blocks;
+                record.map_name = snapshot.map_name;
+                record.base = journalBases.value(snapshot.map_name);
+                QDataStream out(&record.data, QIODevice::WriteOnly);
+                out.setVersion(QDataStream::Qt_5_0);
+                out << qint32(dimensions.width()) << qint32(dimensions.height()) << changes;
+                journal->append(record);
+                journaledBlockdata.insert(snapshot.map_name, blocks);
+                journaledDimensions.insert(snapshot.map_name, dimensions);
+            }
+        }
+
+        if (snapshot.has_events && snapshot.events != journaledEvents.value(snapshot.map_name)) {
+            Journal::Record record;
+            record.type = Journal::Events;
+            record.map_name = snapshot.map_name;
+            record.base = journalBases.value(snapshot.map_name);
+            record.data = snapshot.events;
+            journal->append(record);
+            journaledEvents.insert(snapshot.map_name, snapshot.events);
+        }
+    }
+}
+
+// Applies journaled edits on top of the maps as they were loaded from disk.
+// Edits made on top of files that have since been changed outside of pretmap are skipped,
+// since replaying them would undo those changes. Returns the names of the maps that were changed.
+QStringList Project::replayJournal(QList<Journal::Record> records) {
+    QStringList changed;
+    QMap<QString, QByteArray> bases;
+    for (Journal::Record record : records) {
+        if (!mapNames->contains(record.map_name)) {
+            qDebug() << QString("Skipping journaled edit to unknown map '%1'").arg(record.map_name);
+            continue;
+        }
+        Map *map = getMap(record.map_name);
+        if (!map || !map->layout || !map->layout->blockdata) {
+            continue;
+        }
+        if (!bases.contains(map->name)) {
+            bases.insert(map->name, hashMapSources(getMapSourcePaths(map)));
+        }
+        if (record.base != bases.value(map->name)) {
+            qDebug() << QString("Skipping journaled edit to '%1', which was changed outside of pretmap").arg(record.map_name);
+            continue;
+        }
+
+        QDataStream in(record.data);
+        in.setVersion(QDataStream::Qt_5_0);
+        if (record.type == Journal::Blocks) {
+            qint32 width, height;
+            QList<QPair<quint32, quint16>> changes;
+            in >> width >> height >> changes;
+            if (width != map->getWidth() || height != map->getHeight()) {
+                map->setDimensions(width, height, true);
+            }
+            QList<Block> *blocks = map->layout->blockdata->blocks;
+            for (QPair<quint32, quint16> change : changes) {
+                if (int(change.first) < blocks->length()) {
+                    blocks->replace(int(change.first), Block(change.second));
+                }
+            }
+            map->commit();
+        } else if (record.type == Journal::Events) {
+            QList<QMap<QString, QString>> events;
+            in >> events;
+            for (Event *event : map->getAllEvents()) {
+                delete event;
+            }
+            for (QString group : map->events.keys()) {
+                map->events[group].clear();
+            }
+            // The new events' revisions don't match the saved ones, so the map shows as unsaved.
+            for (QMap<QString, QString> values : events) {
+                Event *event = new Event;
+                event->values = values;
+                map->events[event->get("event_group_type")].append(event);
+            }
+        }
+
+        updateJournalSnapshot(map);
+        if (!changed.contains(map->name)) {
+            changed.append(map->name);
+        }
+    }
+    return changed;
+}
+
+void Project::updateJournalSnapshot(Map *map) {
+    if (!map || !map->layout || !map->layout->blockdata) {
+        return;
+    }
+    journalFuture.waitForFinished();
+    journaledHistory.insert(map->name, map->history.getRevision());
+    journaledEventRevisions.insert(map->name, map->getEventRevisions());
+    journaledBlockdata.insert(map->name, map->layout->blockdata->serialize());
+    journaledDimensions.insert(map->name, QSize(map->getWidth(), map->getHeight()));
+    journaledEvents.insert(map->name, serializeJournalEvents(map));
+    // Taken again by the next diff, since the map may have just been read from or written to disk.
+    journalBases.remove(map->name);
+}
+
+// Identifies the contents of the files a map was read from.
+QByteArray Project::hashMapSources(QStringList paths) {
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    for (QString path : paths) {
+        QFile file(path);
+        if (file.open(QIODevice::ReadOnly)) {
+            hash.addData(&file);
+        }
+    }
+    return hash.result();
+}
+
+QByteArray Project::serializeJournalEvents(Map *map) {
+    QList<QMap<QString, QString>> events;
+    for (QString group : map->events.keys()) {
+        for (Event *event : map->events.value(group)) {
+            events.append(event->values);
+        }
+    }
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << events;
+    return data;
+}
+
+void Project::loadCache() {
+    if (!cache) {
+        cache = new ProjectCache(root);
+    }
+    cache->load();
+}
+
+void Project::saveCache() {
+    if (cache) {
+        cache->save();
+    }
+}
+
+MemoryUsage Project::memoryUsage() {
+    MemoryUsage usage;
+    for (Map *map : map_cache->values()) {
+        usage.add(map->memoryUsage());
+    }
+    for (MapLayout *layout : mapLayouts.values()) {
+        usage.add(layout->memoryUsage());
+    }
+    // Tileset data is interned, so the pool holds each distinct piece of it once.
+    usage.add("tileset data", assets->bytesStored());
+    // Sprites that share graphics share a pixmap.
+    QSet<qint64> sprites;
+    for (QPixmap pixmap : eventObjectSpritePixmaps.values()) {
+        if (!pixmap.isNull() && !sprites.contains(pixmap.cacheKey())) {
+            sprites.insert(pixmap.cacheKey());
+            usage.add("event sprites", MemoryUsage::pixmapBytes(pixmap));
+        }
+    }
+    if (cache) {
+        usage.add("project cache", cache->bytes());
+    }
+    return usage;
+}
+
+qint64 Project::getMapCacheBytes() {
+    qint64 bytes = 0;
+    for (Map *map : map_cache->values()) {
+        bytes += map->memoryUsage().total();
+    }
+    for (MapLayout *layout : mapLayouts.values()) {
+        bytes += layout->memoryUsage().total();
+    }
+    return bytes;
+}
+
+// The breakdown by category, then the maps and tilesets that use the most.
+QStringList Project::memoryReport() {
+    QStringList lines;
+    lines << "Loaded project:";
+    lines << memoryUsage().report();
+
+    QList<QPair<qint64, QString>> maps;
+    for (Map *map : map_cache->values()) {
+        qint64 bytes = map->memoryUsage().total();
+        if (map->layout) {
+            bytes += map->layout->memoryUsage().total();
+        }
+        maps.append(qMakePair(bytes, map->name));
+    }
+    std::sort(maps.begin(), maps.end());
+    lines << "" << QString("Largest of %1 loaded maps:").arg(maps.length());
+    for (int i = maps.length() - 1; i >= 0 && i >= maps.length() - 10; i--) {
+        lines << QString("%1  %2").arg(MemoryUsage::formatBytes(maps.value(i).first), 10).arg(maps.value(i).second);
+    }
+
+    lines << "" << QString("%1 loaded tilesets, before sharing:").arg(tileset_cache->size());
+    for (QString label : tileset_cache->keys()) {
+        Tileset *tileset = tileset_cache->value(label);
+        if (tileset) {
+            lines << QString("%1  %2").arg(MemoryUsage::formatBytes(tileset->memoryUsage().total()), 10).arg(label);
+        }
+    }
+    lines << "" << QString("Sharing tileset data saves %1 (%2 kept for %3 loaded)")
+             .arg(MemoryUsage::formatBytes(assets->bytesRequested() - assets->bytesStored()))
+             .arg(MemoryUsage::formatBytes(assets->bytesStored()))
+             .arg(MemoryUsage::formatBytes(assets->bytesRequested()));
+    return lines;
+}
+
+// Reads and parses an asm file, reusing the parsed output from the project cache
+// if the file hasn't changed since it was last parsed.
+QList<QStringList>* Project::readAsmFile(QString path) {
+    TRACE_ZONE("Project::readAsmFile", "parse");
+    QString key = "asm:" + path;
+    QStringList sources = QStringList() << path;
+    QByteArray data;
+    if (cache && cache->get(key, sources, &data)) {
+        QDataStream in(data);
+        in.setVersion(QDataStream::Qt_5_0);
+        QList<QStringList> *commands = new QList<QStringList>;
+        in >> *commands;
+        return commands;
+    }
+
+    QString text = readTextFile(path);
+    if (text.isNull()) {
+        return NULL;
+    }
+    QList<QStringList> *commands = parseAsm(text);
+    if (cache) {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << *commands;
+        cache->put(key, sources, data);
+    }
+    return commands;
+}
+
+QMap<QString, int> Project::readCDefinesFile(QString path, QStringList prefixes) {
+    TRACE_ZONE("Project::readCDefinesFile", "parse");
+    QString key = "defines:" + path + ":" + prefixes.join(",");
+    QStringList sources = QStringList() << path;
+    QByteArray data;
+    QMap<QString, int> defines;
+    if (cache && cache->get(key, sources, &data)) {
+        QDataStream in(data);
+        in.setVersion(QDataStream::Qt_5_0);
+        in >> defines;
+        return defines;
+    }
+
+    QString text = readTextFile(path);
+    if (text.isNull()) {
+        return defines;
+    }
+    defines = readCDefines(text, prefixes);
+    if (cache) {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << defines;
+        cache->put(key, sources, data);
+    }
+    return defines;
+}
+
 QString Project::readTextFile(QString path) {
     QFile file(path);
     if (!file.open(QIODevice::ReadOnly)) {
@@ -861,16 +1750,121 @@ QString Project::readTextFile(QString path) {
     return text;
 }
 
+// Until commitSave is called, files written by the project are only staged, and none of them
+// are touched on disk. Then they're all written at once, or not at all if any of them fail.
+void Project::beginSave() {
+    if (!saveTransaction) {
+        saveTransaction = new SaveTransaction(root);
+    }
+}
+
+bool Project::commitSave(std::function<void(int, int)> progress) {
+    TRACE_ZONE("Project::commitSave", "save");
+    if (!saveTransaction) {
+        return true;
+    }
+    SaveTransaction *transaction = saveTransaction;
+    saveTransaction = NULL;
+
+    bool success = transaction->commit(progress);
+    if (success) {
+        for (QString path : pendingSavedFiles.keys()) {
+            savedFiles.insert(path, QPair<QByteArray, QDateTime>(pendingSavedFiles.value(path), QFileInfo(path).lastModified()));
+        }
+        // The saved maps' edits are on disk now, so they don't need to be recovered anymore.
+        for (QString map_name : savedMapNames) {
+            markMapSaved(map_cache->value(map_name));
+            updateJournalSnapshot(map_cache->value(map_name));
+        }
+        // Maps that share a layout (or anything else) with the saved ones are based on new files now too.
+        journalFuture.waitForFinished();
+        journalBases.clear();
+        if (journal) {
+            journal->discard(savedMapNames);
+        }
+    } else {
+        qDebug() << "Failed to save project: " + transaction->errorString;
+    }
+    pendingSavedFiles.clear();
+    savedMapNames.clear();
+    delete transaction;
+    return success;
+}
+
 void Project::saveTextFile(QString path, QString text) {
+    writeFileIfChanged(path, text.toUtf8());
+}
+
+// Saving regenerates every file a map or table is stored in. Only the ones whose
+// contents actually changed are written, so the rest keep their timestamps and
+// don't trigger rebuilds. Returns true if the file was written.
+bool Project::writeFileIfChanged(QString path, QByteArray data) {
+    QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+    QByteArray staged;
+    if (saveTransaction && saveTransaction->staged(path, &staged)) {
+        // Already written once during this save. The disk no longer tells us anything.
+        if (staged != data) {
+            saveTransaction->write(path, data);
+            pendingSavedFiles.insert(path, hash);
+        }
+        return true;
+    }
+
+    QFileInfo info(path);
+    if (savedFiles.contains(path)) {
+        // The file is still what was last written, unless it was modified outside of pretmap.
+        // An edit right after a save can keep the same timestamp on coarse filesystems, so recent
+        // files are compared with what's on disk below instead.
+        QPair<QByteArray, QDateTime> saved = savedFiles.value(path);
+        if (saved.first == hash && info.exists() && info.size() == data.size()
+         && info.lastModified() == saved.second
+         && saved.second.msecsTo(QDateTime::currentDateTime()) > 2000) {
+            return false;
+        }
+    }
+
     QFile file(path);
-    if (file.open(QIODevice::WriteOnly)) {
-        file.write(text.toUtf8());
-    } else {
+    if (info.exists() && info.size() == data.size() && file.open(QIODevice::ReadOnly)) {
+        bool unchanged = file.readAll() == data;
+        file.close();
+        if (unchanged) {
+            savedFiles.insert(path, QPair<QByteArray, QDateTime>(hash, info.lastModified()));
+            return false;
+        }
+    }
+
+    if (saveTransaction) {
+        saveTransaction->write(path, data);
+        pendingSavedFiles.insert(path, hash);
+        return true;
+    }
+
+    QDir().mkpath(info.absolutePath());
+    if (!file.open(QIODevice::WriteOnly)) {
         qDebug() << QString("Could not open '%1' for writing: ").arg(path) + file.errorString();
+        return false;
     }
+    file.write(data);
+    file.close();
+    savedFiles.insert(path, QPair<QByteArray, QDateTime>(hash, QFileInfo(path).lastModified()));
+    return true;
 }
 
 void Project::appendTextFile(QString path, QString text) {
+    if (saveTransaction) {
+        QByteArray data;
+        if (!saveTransaction->staged(path, &data)) {
+            QFile file(path);
+            if (file.open(QIODevice::ReadOnly)) {
+                data = file.readAll();
+            }
+        }
+        data += text.toUtf8();
+        saveTransaction->write(path, data);
+        pendingSavedFiles.insert(path, QCryptographicHash::hash(data, QCryptographicHash::Md5));
+        return;
+    }
+
     QFile file(path);
     if (file.open(QIODevice::Append)) {
         file.write(text.toUtf8());
@@ -880,19 +1874,44 @@ void Project::appendTextFile(QString path, QString text) {
 }
 
 void Project::deleteFile(QString path) {
+    if (saveTransaction) {
+        saveTransaction->remove(path);
+        pendingSavedFiles.remove(path);
+        savedFiles.remove(path);
+        return;
+    }
+
     QFile file(path);
     if (file.exists() && !file.remove()) {
         qDebug() << QString("Could not delete file '%1': ").arg(path) + file.errorString();
     }
+    savedFiles.remove(path);
+}
+
+void Project::readDataStructures() {
+    TRACE_ZONE("Project::readDataStructures", "project");
+    readMapLayoutsTable();
+    readAllMapLayouts();
+    readRegionMapSections();
+    readItemNames();
+    readFlagNames();
+    readVarNames();
+    readMovementTypes();
+    readMapTypes();
+    readMapBattleScenes();
+    readWeatherNames();
+    readCoordEventWeatherNames();
+    readSecretBaseIds();
+    readBgEventFacingDirections();
+    readMapsWithConnections();
 }
 
 void Project::readMapGroups() {
-    QString text = readTextFile(root + "/data/maps/groups.inc");
-    if (text.isNull()) {
+    TRACE_ZONE("Project::readMapGroups", "project");
+    QList<QStringList> *commands = readAsmFile(root + "/data/maps/groups.inc");
+    if (commands == NULL) {
         return;
     }
-    ParseUtil *parser = new ParseUtil;
-    QList<QStringList> *commands = parser->parseAsm(text);
 
     bool in_group_pointers = false;
     QStringList *groups = new QStringList;
@@ -947,6 +1966,7 @@ void Project::readMapGroups() {
     groupNames = groups;
     groupedMapNames = groupedMaps;
     mapNames = maps;
+    delete commands;
 }
 
 Map* Project::addNewMapToGroup(QString mapName, int groupNum) {
@@ -986,8 +2006,8 @@ QString Project::getNewMapName() {
 }
 
 QList<QStringList>* Project::parseAsm(QString text) {
-    ParseUtil *parser = new ParseUtil;
-    return parser->parseAsm(text);
+    ParseUtil parser;
+    return parser.parseAsm(text);
 }
 
 QStringList Project::getVisibilities() {
@@ -1005,8 +2025,10 @@ QMap<QString, QStringList> Project::getTilesets() {
     QStringList secondaryTilesets;
     allTilesets.insert("primary", primaryTilesets);
     allTilesets.insert("secondary", secondaryTilesets);
-    QString headers_text = readTextFile(root + "/data/tilesets/headers.inc");
-    QList<QStringList>* commands = parseAsm(headers_text);
+    QList<QStringList>* commands = readAsmFile(root + "/data/tilesets/headers.inc");
+    if (commands == NULL) {
+        return allTilesets;
+    }
     int i = 0;
     while (i < commands->length()) {
         if (commands->at(i).length() != 2)
@@ -1037,6 +2059,7 @@ QMap<QString, QStringList> Project::getTilesets() {
         i++;
     }
 
+    delete commands;
     return allTilesets;
 }
 
@@ -1107,9 +2130,8 @@ void Project::readBgEventFacingDirections() {
 }
 
 void Project::readCDefinesSorted(QString filepath, QStringList prefixes, QStringList* definesToSet) {
-    QString text = readTextFile(filepath);
-    if (!text.isNull()) {
-        QMap<QString, int> defines = readCDefines(text, prefixes);
+    if (QFile::exists(filepath)) {
+        QMap<QString, int> defines = readCDefinesFile(filepath, prefixes);
 
         // The defines should to be sorted by their underlying value, not alphabetically.
         // Reverse the map and read out the resulting keys in order.
@@ -1125,14 +2147,13 @@ void Project::readCDefinesSorted(QString filepath, QStringList prefixes, QString
 
 void Project::readMapsWithConnections() {
     QString path = root + "/data/maps/connections.inc";
-    QString text = readTextFile(path);
-    if (text.isNull()) {
+    QList<QStringList>* includes = readAsmFile(path);
+    if (includes == NULL) {
         return;
     }
 
     mapsWithConnections.clear();
     QRegularExpression re("data\\/maps\\/(?<mapName>\\w+)\\/connections.inc");
-    QList<QStringList>* includes = parseAsm(text);
     for (QStringList values : *includes) {
         if (values.length() != 2)
             continue;
@@ -1143,42 +2164,33 @@ void Project::readMapsWithConnections() {
             mapsWithConnections.append(mapName);
         }
     }
+    delete includes;
 }
 
 void Project::saveMapsWithConnections() {
     QString path = root + "/data/maps/connections.inc";
-    QString text = "";
+    TextWriter writer(mapsWithConnections.length() * 64);
     for (QString mapName : mapsWithConnections) {
         if (mapNamesToMapConstants->contains(mapName)) {
-            text += QString("\t.include \"data/maps/%1/connections.inc\"\n").arg(mapName);
+            writer << "\t.include \"data/maps/" << mapName << "/connections.inc\"\n";
         } else {
             qDebug() << QString("Failed to write connection include. %1 not a valid map name").arg(mapName);
         }
     }
-    saveTextFile(path, text);
+    writeFileIfChanged(path, writer.data);
 }
 
 QStringList Project::getSongNames() {
-    QStringList names;
-    QString text = readTextFile(root + "/include/constants/songs.h");
-    if (!text.isNull()) {
-        QStringList songDefinePrefixes;
-        songDefinePrefixes << "SE_" << "MUS_";
-        QMap<QString, int> songDefines = readCDefines(text, songDefinePrefixes);
-        names = songDefines.keys();
-    }
-    return names;
+    QStringList songDefinePrefixes;
+    songDefinePrefixes << "SE_" << "MUS_";
+    QMap<QString, int> songDefines = readCDefinesFile(root + "/include/constants/songs.h", songDefinePrefixes);
+    return songDefines.keys();
 }
 
 QMap<QString, int> Project::getEventObjGfxConstants() {
-    QMap<QString, int> constants;
-    QString text = readTextFile(root + "/include/constants/event_objects.h");
-    if (!text.isNull()) {
-        QStringList eventObjGfxPrefixes;
-        eventObjGfxPrefixes << "EVENT_OBJ_GFX_";
-        constants = readCDefines(text, eventObjGfxPrefixes);
-    }
-    return constants;
+    QStringList eventObjGfxPrefixes;
+    eventObjGfxPrefixes << "EVENT_OBJ_GFX_";
+    return readCDefinesFile(root + "/include/constants/event_objects.h", eventObjGfxPrefixes);
 }
 
 QString Project::fixGraphicPath(QString path) {
@@ -1188,18 +2200,96 @@ QString Project::fixGraphicPath(QString path) {
 }
 
 void Project::loadEventPixmaps(QList<Event*> objects) {
-    bool needs_update = false;
+    TRACE_ZONE("Project::loadEventPixmaps", "project");
+    QStringList sprites = applyEventPixmaps(objects);
+    if (!sprites.isEmpty()) {
+        cacheEventObjectSpriteImages(readEventObjectSpriteImages(sprites));
+        applyEventPixmaps(objects);
+    }
+}
+
+// Gives events without a pixmap their placeholder icon, and object events whose sprite is
+// already loaded their sprite. Returns the sprites that haven't been loaded yet.
+QStringList Project::applyEventPixmaps(QList<Event*> objects) {
+    QStringList sprites;
     for (Event *object : objects) {
+        QString event_type = object->get("event_type");
         if (object->pixmap.isNull()) {
-            needs_update = true;
-            break;
+            if (event_type == EventType::Object) {
+                object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(0, 0, 16, 16);
+            } else if (event_type == EventType::Warp) {
+                object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(16, 0, 16, 16);
+            } else if (event_type == EventType::CoordScript || event_type == EventType::CoordWeather) {
+                object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(32, 0, 16, 16);
+            } else if (event_type == EventType::Sign || event_type == EventType::HiddenItem || event_type == EventType::SecretBase) {
+                object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(48, 0, 16, 16);
+            }
+        }
+
+        if (event_type == EventType::Object) {
+            QString sprite = object->get("sprite");
+            if (!eventObjectSpritePixmaps.contains(sprite)) {
+                if (!sprites.contains(sprite)) {
+                    sprites.append(sprite);
+                }
+            } else if (!eventObjectSpritePixmaps.value(sprite).isNull()) {
+                object->pixmap = eventObjectSpritePixmaps.value(sprite);
+            }
         }
     }
-    if (!needs_update) {
-        return;
+    return sprites;
+}
+
+// Finds and decodes the graphics of each sprite. This is the slow part of loading events,
+// so it's safe to call from other threads. Sprites with no graphics get a null image.
+QMap<QString, QImage> Project::readEventObjectSpriteImages(QStringList sprites) {
+    TRACE_ZONE("Project::readEventObjectSpriteImages", "project");
+    {
+        QMutexLocker locker(&eventObjectSpritesMutex);
+        if (!eventObjectSpritesIndexed) {
+            indexEventObjectSprites();
+        }
+    }
+
+    // Many sprites share graphics, so each file is only decoded once.
+    QMap<QString, QImage> images_by_path;
+    QMap<QString, QImage> images;
+    for (QString sprite : sprites) {
+        int sprite_id = eventObjectGfxConstants.value(sprite);
+        QString path = eventObjectSpritePaths.value(sprite_id);
+        if (path.isNull()) {
+            images.insert(sprite, QImage());
+            continue;
+        }
+        if (!images_by_path.contains(path)) {
+            images_by_path.insert(path, QImage(root + "/" + path));
+        }
+        images.insert(sprite, images_by_path.value(path));
+    }
+    return images;
+}
+
+// Must be called on the GUI thread, since it makes pixmaps.
+void Project::cacheEventObjectSpriteImages(QMap<QString, QImage> images) {
+    QMap<qint64, QPixmap> pixmaps;
+    for (QString sprite : images.keys()) {
+        QImage image = images.value(sprite);
+        if (image.isNull()) {
+            eventObjectSpritePixmaps.insert(sprite, QPixmap());
+            continue;
+        }
+        if (!pixmaps.contains(image.cacheKey())) {
+            pixmaps.insert(image.cacheKey(), QPixmap::fromImage(image));
+        }
+        eventObjectSpritePixmaps.insert(sprite, pixmaps.value(image.cacheKey()));
     }
+}
 
-    QMap<QString, int> constants = getEventObjGfxConstants();
+// Resolves every event object sprite constant to its graphics path in one pass over the
+// graphics info tables, instead of searching the tables again for each object.
+void Project::indexEventObjectSprites() {
+    eventObjectGfxConstants = getEventObjGfxConstants();
+    eventObjectSpritePaths.clear();
 
     QString pointers_text = readTextFile(root + "/src/data/field_event_obj/event_object_graphics_info_pointers.h");
     QString info_text = readTextFile(root + "/src/data/field_event_obj/event_object_graphics_info.h");
@@ -1207,111 +2297,107 @@ void Project::loadEventPixmaps(QList<Event*> objects) {
     QString assets_text = readTextFile(root + "/src/data/field_event_obj/event_object_graphics.h");
 
     QStringList pointers = readCArray(pointers_text, "gEventObjectGraphicsInfoPointers");
-
-    for (Event *object : objects) {
-        if (!object->pixmap.isNull()) {
-            continue;
-        }
-        QString event_type = object->get("event_type");
-        if (event_type == EventType::Object) {
-            object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(0, 0, 16, 16);
-        } else if (event_type == EventType::Warp) {
-            object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(16, 0, 16, 16);
-        } else if (event_type == EventType::CoordScript || event_type == EventType::CoordWeather) {
-            object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(32, 0, 16, 16);
-        } else if (event_type == EventType::Sign || event_type == EventType::HiddenItem || event_type == EventType::SecretBase) {
-            object->pixmap = QPixmap(":/images/Entities_16x16.png").copy(48, 0, 16, 16);
+    QMap<QString, QStringList> infos = readCArrays(info_text);
+    QMap<QString, QStringList> pics = readCArrays(pic_text);
+    QMap<QString, QString> incbins = readCIncbins(assets_text);
+
+    for (QString pointer : pointers) {
+        QString info_label = pointer.replace("&", "");
+        QString pic_label = infos.value(info_label).value(14);
+        QString gfx_label = pics.value(pic_label).value(0);
+        gfx_label = gfx_label.section(QRegExp("[\\(\\)]"), 1, 1);
+        QString path = incbins.value(gfx_label);
+        if (!path.isNull()) {
+            path = fixGraphicPath(path);
         }
+        eventObjectSpritePaths.append(path);
+    }
 
-        if (event_type == EventType::Object) {
-            int sprite_id = constants.value(object->get("sprite"));
-
-            QString info_label = pointers.value(sprite_id).replace("&", "");
-            QString pic_label = readCArray(info_text, info_label).value(14);
-            QString gfx_label = readCArray(pic_text, pic_label).value(0);
-            gfx_label = gfx_label.section(QRegExp("[\\(\\)]"), 1, 1);
-            QString path = readCIncbin(assets_text, gfx_label);
-
-            if (!path.isNull()) {
-                path = fixGraphicPath(path);
-                QPixmap pixmap(root + "/" + path);
-                if (!pixmap.isNull()) {
-                    object->pixmap = pixmap;
-                }
-            }
-        }
+    eventObjectSpritesIndexed = true;
+}
+
+// Sprites are shared by many events across maps, so each one is only loaded once.
+QPixmap Project::getEventObjectSpritePixmap(QString sprite) {
+    if (!eventObjectSpritePixmaps.contains(sprite)) {
+        cacheEventObjectSpriteImages(readEventObjectSpriteImages(QStringList() << sprite));
     }
+    return eventObjectSpritePixmaps.value(sprite);
 }
 
 void Project::saveMapEvents(Map *map) {
     QString path = root + QString("/data/maps/%1/events.inc").arg(map->name);
-    QString text = "";
     QString objectEventsLabel = "0x0";
     QString warpEventsLabel = "0x0";
     QString coordEventsLabel = "0x0";
     QString bgEventsLabel = "0x0";
 
+    int numEvents = 0;
+    for (QList<Event*> events : map->events.values()) {
+        numEvents += events.length();
+    }
+    TextWriter writer(512 + numEvents * 128);
+
     if (map->events["object_event_group"].length() > 0) {
         objectEventsLabel = Map::objectEventsLabelFromName(map->name);
-        text += QString("%1::\n").arg(objectEventsLabel);
+        writer.label(objectEventsLabel);
         for (int i = 0; i < map->events["object_event_group"].length(); i++) {
             Event *object_event = map->events["object_event_group"].value(i);
-            text += object_event->buildObjectEventMacro(i);
+            object_event->buildObjectEventMacro(&writer, i);
         }
-        text += "\n";
+        writer << "\n";
     }
 
     if (map->events["warp_event_group"].length() > 0) {
         warpEventsLabel = Map::warpEventsLabelFromName(map->name);
-        text += QString("%1::\n").arg(warpEventsLabel);
+        writer.label(warpEventsLabel);
         for (Event *warp : map->events["warp_event_group"]) {
-            text += warp->buildWarpEventMacro(mapNamesToMapConstants);
+            warp->buildWarpEventMacro(&writer, mapNamesToMapConstants);
         }
-        text += "\n";
+        writer << "\n";
     }
 
     if (map->events["coord_event_group"].length() > 0) {
         coordEventsLabel = Map::coordEventsLabelFromName(map->name);
-        text += QString("%1::\n").arg(coordEventsLabel);
+        writer.label(coordEventsLabel);
         for (Event *event : map->events["coord_event_group"]) {
             QString event_type = event->get("event_type");
             if (event_type == EventType::CoordScript) {
-                text += event->buildCoordScriptEventMacro();
+                event->buildCoordScriptEventMacro(&writer);
             } else if (event_type == EventType::CoordWeather) {
-                text += event->buildCoordWeatherEventMacro();
+                event->buildCoordWeatherEventMacro(&writer);
             }
         }
-        text += "\n";
+        writer << "\n";
     }
 
     if (map->events["bg_event_group"].length() > 0)
     {
         bgEventsLabel = Map::bgEventsLabelFromName(map->name);
-        text += QString("%1::\n").arg(bgEventsLabel);
+        writer.label(bgEventsLabel);
         for (Event *event : map->events["bg_event_group"]) {
             QString event_type = event->get("event_type");
             if (event_type == EventType::Sign) {
-                text += event->buildSignEventMacro();
+                event->buildSignEventMacro(&writer);
             } else if (event_type == EventType::HiddenItem) {
-                text += event->buildHiddenItemEventMacro();
+                event->buildHiddenItemEventMacro(&writer);
             } else if (event_type == EventType::SecretBase) {
-                text += event->buildSecretBaseEventMacro();
+                event->buildSecretBaseEventMacro(&writer);
             }
         }
-        text += "\n";
+        writer << "\n";
     }
 
-    text += QString("%1::\n").arg(map->events_label);
-    text += QString("\tmap_events %1, %2, %3, %4\n")
-            .arg(objectEventsLabel)
-            .arg(warpEventsLabel)
-            .arg(coordEventsLabel)
-            .arg(bgEventsLabel);
+    writer.label(map->events_label);
+    writer << "\tmap_events " << objectEventsLabel
+           << ", " << warpEventsLabel
+           << ", " << coordEventsLabel
+           << ", " << bgEventsLabel << "\n";
 
-    saveTextFile(path, text);
+    writeFileIfChanged(path, writer.data);
 }
 
 void Project::readMapEvents(Map *map) {
+    TRACE_ZONE("Project::readMapEvents", "parse");
     if (!map->isPersistedToFile) {
         return;
     }
@@ -1323,15 +2409,20 @@ void Project::readMapEvents(Map *map) {
         return;
     }
 
-    QStringList *labels = getLabelValues(parseAsm(text), map->events_label);
-    QString objectEventsLabel = labels->value(0);
-    QString warpEventsLabel = labels->value(1);
-    QString coordEventsLabel = labels->value(2);
-    QString bgEventsLabel = labels->value(3);
+    // Parse the file once and look up each event group's label in it.
+    QList<QStringList> *commands = parseAsm(text);
+    AsmLabelIndex index(commands, path);
+    delete commands;
+
+    QStringList labels = index.values(map->events_label);
+    QString objectEventsLabel = labels.value(0);
+    QString warpEventsLabel = labels.value(1);
+    QString coordEventsLabel = labels.value(2);
+    QString bgEventsLabel = labels.value(3);
 
-    QList<QStringList> *object_events = getLabelMacros(parseAsm(text), objectEventsLabel);
+    qDeleteAll(map->events["object_event_group"]);
     map->events["object_event_group"].clear();
-    for (QStringList command : *object_events) {
+    for (QStringList command : index.macros(objectEventsLabel)) {
         if (command.value(0) == "object_event") {
             Event *object = new Event;
             object->put("map_name", map->name);
@@ -1354,9 +2445,9 @@ void Project::readMapEvents(Map *map) {
         }
     }
 
-    QList<QStringList> *warps = getLabelMacros(parseAsm(text), warpEventsLabel);
+    qDeleteAll(map->events["warp_event_group"]);
     map->events["warp_event_group"].clear();
-    for (QStringList command : *warps) {
+    for (QStringList command : index.macros(warpEventsLabel)) {
         if (command.value(0) == "warp_def") {
             Event *warp = new Event;
             warp->put("map_name", map->name);
@@ -1379,9 +2470,9 @@ void Project::readMapEvents(Map *map) {
         }
     }
 
-    QList<QStringList> *coords = getLabelMacros(parseAsm(text), coordEventsLabel);
+    qDeleteAll(map->events["coord_event_group"]);
     map->events["coord_event_group"].clear();
-    for (QStringList command : *coords) {
+    for (QStringList command : index.macros(coordEventsLabel)) {
         if (command.value(0) == "coord_event") {
             Event *coord = new Event;
             coord->put("map_name", map->name);
@@ -1409,9 +2500,9 @@ void Project::readMapEvents(Map *map) {
         }
     }
 
-    QList<QStringList> *bgs = getLabelMacros(parseAsm(text), bgEventsLabel);
+    qDeleteAll(map->events["bg_event_group"]);
     map->events["bg_event_group"].clear();
-    for (QStringList command : *bgs) {
+    for (QStringList command : index.macros(bgEventsLabel)) {
         if (command.value(0) == "bg_event") {
             Event *bg = new Event;
             bg->put("map_name", map->name);
@@ -1466,10 +2557,10 @@ QStringList Project::readCArray(QString text, QString label) {
         return list;
     }
 
-    QRegExp *re = new QRegExp(QString("\\b%1\\b\\s*\\[?\\s*\\]?\\s*=\\s*\\{([^\\}]*)\\}").arg(label));
-    int pos = re->indexIn(text);
+    QRegExp re(QString("\\b%1\\b\\s*\\[?\\s*\\]?\\s*=\\s*\\{([^\\}]*)\\}").arg(label));
+    int pos = re.indexIn(text);
     if (pos != -1) {
-        QString body = re->cap(1);
+        QString body = re.cap(1);
         body = body.replace(QRegExp("\\s*"), "");
         list = body.split(',');
         /*
@@ -1492,21 +2583,58 @@ QString Project::readCIncbin(QString text, QString label) {
         return path;
     }
 
-    QRegExp *re = new QRegExp(QString(
+    QRegExp re(QString(
         "\\b%1\\b"
         "\\s*\\[?\\s*\\]?\\s*=\\s*"
         "INCBIN_[US][0-9][0-9]?"
         "\\(\"([^\"]*)\"\\)").arg(label));
 
-    int pos = re->indexIn(text);
+    int pos = re.indexIn(text);
     if (pos != -1) {
-        path = re->cap(1);
+        path = re.cap(1);
     }
 
     return path;
 }
 
+// Like readCArray, but reads every array in the text at once, keyed by label.
+QMap<QString, QStringList> Project::readCArrays(QString text) {
+    QMap<QString, QStringList> arrays;
+    QRegularExpression re("\\b(?<label>\\w+)\\s*\\[?\\s*\\]?\\s*=\\s*\\{(?<body>[^\\}]*)\\}");
+    QRegularExpressionMatchIterator iter = re.globalMatch(text);
+    while (iter.hasNext()) {
+        QRegularExpressionMatch match = iter.next();
+        QString label = match.captured("label");
+        if (!arrays.contains(label)) {
+            QString body = match.captured("body");
+            body = body.replace(QRegExp("\\s*"), "");
+            arrays.insert(label, body.split(','));
+        }
+    }
+    return arrays;
+}
+
+// Like readCIncbin, but reads every incbin in the text at once, keyed by label.
+QMap<QString, QString> Project::readCIncbins(QString text) {
+    QMap<QString, QString> incbins;
+    QRegularExpression re(
+        "\\b(?<label>\\w+)"
+        "\\s*\\[?\\s*\\]?\\s*=\\s*"
+        "INCBIN_[US][0-9][0-9]?"
+        "\\(\"(?<path>[^\"]*)\"\\)");
+    QRegularExpressionMatchIterator iter = re.globalMatch(text);
+    while (iter.hasNext()) {
+        QRegularExpressionMatch match = iter.next();
+        QString label = match.captured("label");
+        if (!incbins.contains(label)) {
+            incbins.insert(label, match.captured("path"));
+        }
+    }
+    return incbins;
+}
+
 QMap<QString, int> Project::readCDefines(QString text, QStringList prefixes) {
+    TRACE_ZONE("Project::readCDefines", "parse");
     ParseUtil parser;
     QMap<QString, int> allDefines;
     QMap<QString, int> filteredDefines;
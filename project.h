@@ -3,10 +3,23 @@
 
 #include "map.h"
 #include "blockdata.h"
+#include "projectcache.h"
+#include "savetransaction.h"
+#include "journal.h"
+#include "mapformat.h"
+#include "assetpool.h"
 
 #include <QStringList>
 #include <QList>
 #include <QStandardItem>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QSize>
+#include <QImage>
+#include <QFuture>
+
+class ProjectWatcher;
 
 class Project
 {
@@ -42,16 +55,48 @@ public:
 
     QMap<QString, Tileset*> *tileset_cache = NULL;
     Tileset* loadTileset(QString);
+    Tileset* readTileset(QString);
+    Tileset* cacheTileset(QString, Tileset*);
+    void deleteTileset(Tileset*);
     Tileset* getTileset(QString);
+    QMap<Tileset*, Tileset*> replaceTilesets(QMap<QString, Tileset*> tilesets);
 
     Blockdata* readBlockdata(QString);
     void loadBlockdata(Map*);
 
+    ProjectCache *cache = NULL;
+    AssetPool *assets = NULL;
+    Journal *journal = NULL;
+    ProjectWatcher *watcher = NULL;
+    QStringList getMapSourcePaths(Map *map);
+    bool matchesSavedFile(QString path);
+    void reloadMap(Map *map);
+
+    // Which format maps are read from. Asm is always written too, since that's what gets built.
+    MapFormat::Format map_format = MapFormat::Asm;
+    bool exportMaps(MapFormat::Format format, std::function<void(int, int)> progress = nullptr);
+    bool importMaps(MapFormat::Format format, std::function<void(int, int)> progress = nullptr);
+    void startJournal();
+    void stopJournal();
+    void journalChanges();
+    QStringList replayJournal(QList<Journal::Record> records);
+    void loadCache();
+    void saveCache();
+
+    MemoryUsage memoryUsage();
+    QStringList memoryReport();
+    QList<QStringList>* readAsmFile(QString path);
+    QMap<QString, int> readCDefinesFile(QString path, QStringList prefixes);
+
     QString readTextFile(QString path);
+    void beginSave();
+    bool commitSave(std::function<void(int, int)> progress = nullptr);
     void saveTextFile(QString path, QString text);
+    bool writeFileIfChanged(QString path, QByteArray data);
     void appendTextFile(QString path, QString text);
     void deleteFile(QString path);
 
+    void readDataStructures();
     void readMapGroups();
     Map* addNewMapToGroup(QString mapName, int groupNum);
     QString getNewMapName();
@@ -63,6 +108,19 @@ public:
     void readMapLayoutsTable();
     void readAllMapLayouts();
     QStringList* readLayoutValues(QString layoutName);
+    MapLayout* getMapLayout(QString layoutLabel);
+    bool loadMapLayout(MapLayout*);
+    QString readMapLayoutLabel(QString mapName);
+    QStringList readMapTilesetLabels(QString mapName);
+    QStringList getAdjacentMapNames(QString mapName);
+    QStringList getLinkedMapNames(Map *map);
+    void prefetchMapLayouts(QStringList mapNames);
+    void cancelPrefetches();
+    bool prefetch_layouts = true;
+    bool prefetch_maps = true;
+    // Maps are only prefetched while the maps and layouts in memory take up less than this.
+    qint64 map_cache_budget = 128 * 1024 * 1024;
+    qint64 getMapCacheBytes();
     void readMapLayout(Map*);
     void readMapsWithConnections();
     void loadMapTilesets(Map*);
@@ -71,7 +129,7 @@ public:
     void saveBlockdata(Map*);
     void saveMapBorder(Map*);
     void writeBlockdata(QString, Blockdata*);
-    void saveAllMaps();
+    void saveAllMaps(bool include_unchanged = false);
     void saveMap(Map*);
     void saveAllDataStructures();
     void saveAllMapLayouts();
@@ -95,7 +153,12 @@ public:
     void readBgEventFacingDirections();
 
     void loadEventPixmaps(QList<Event*> objects);
+    QStringList applyEventPixmaps(QList<Event*> objects);
+    QMap<QString, QImage> readEventObjectSpriteImages(QStringList sprites);
+    void cacheEventObjectSpriteImages(QMap<QString, QImage> images);
     QMap<QString, int> getEventObjGfxConstants();
+    void indexEventObjectSprites();
+    QPixmap getEventObjectSpritePixmap(QString sprite);
     QString fixGraphicPath(QString path);
 
     void readMapEvents(Map *map);
@@ -107,6 +170,8 @@ public:
 
     QStringList readCArray(QString text, QString label);
     QString readCIncbin(QString text, QString label);
+    QMap<QString, QStringList> readCArrays(QString text);
+    QMap<QString, QString> readCIncbins(QString text);
     QMap<QString, int> readCDefines(QString text, QStringList prefixes);
 private:
     QString getMapLayoutsTableFilepath();
@@ -117,8 +182,11 @@ private:
     void saveMapsWithConnections();
     void saveMapLayoutsTable();
     void updateMapLayout(Map*);
+    void markMapSaved(Map*);
     void readCDefinesSorted(QString, QStringList, QStringList*);
     void readCDefinesSorted(QString, QStringList, QStringList*, QString, int);
+    QByteArray readTilesetTiles(QString path);
+    QList<QList<QRgb>>* readTilesetPalettes(QStringList paths);
 
     void setNewMapHeader(Map* map, int mapIndex);
     void setNewMapLayout(Map* map);
@@ -126,6 +194,54 @@ private:
     void setNewMapBorder(Map *map);
     void setNewMapEvents(Map *map);
     void setNewMapConnections(Map *map);
+
+    void readMap(Map *map);
+    bool readMapDocument(Map *map);
+    bool readLayoutDocument(MapLayout *layout);
+    void saveMapDocument(Map *map, MapFormat::Format format);
+
+    bool eventObjectSpritesIndexed = false;
+    QMutex eventObjectSpritesMutex;
+    QMap<QString, int> eventObjectGfxConstants;
+    QStringList eventObjectSpritePaths;
+    // Keyed by sprite constant. Sprites with no graphics have a null pixmap.
+    QMap<QString, QPixmap> eventObjectSpritePixmaps;
+
+    QMap<QString, QPair<QByteArray, QDateTime>> savedFiles;
+    SaveTransaction *saveTransaction = NULL;
+    QStringList savedMapNames;
+
+    // What journalChanges() copies out of a map that changed. It's compared with
+    // what was journaled before on a worker, by diffJournalSnapshots().
+    class JournalSnapshot {
+    public:
+        QString map_name;
+        QStringList source_paths; // Only if the map's base hasn't been taken yet.
+        bool has_blocks = false;
+        QByteArray blocks;
+        QSize dimensions;
+        bool has_events = false;
+        QByteArray events;
+    };
+
+    void updateJournalSnapshot(Map *map);
+    void diffJournalSnapshots(QList<JournalSnapshot> snapshots);
+    QByteArray serializeJournalEvents(Map *map);
+    static QByteArray hashMapSources(QStringList paths);
+    // The worker's. It's waited for before anything else touches the journaled snapshots.
+    QFuture<void> journalFuture;
+    QMap<QString, quint64> journaledHistory;
+    QMap<QString, QList<quint64>> journaledEventRevisions;
+    QMap<QString, QByteArray> journaledBlockdata;
+    QMap<QString, QSize> journaledDimensions;
+    QMap<QString, QByteArray> journaledEvents;
+    QMap<QString, QByteArray> journalBases;
+    QMap<QString, QByteArray> pendingSavedFiles;
+
+    QMutex layoutPrefetchMutex;
+    QMap<QString, QStringList> prefetchedLayoutValues;
+    QList<QFuture<void>> layoutPrefetches;
+    QAtomicInt layoutPrefetchesCancelled;
 };
 
 #endif // PROJECT_H
@@ -0,0 +1,252 @@
+#include "projectcache.h"
+#include "perfcounters.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QHash>
+
+const quint32 ProjectCache::magic = 0x504d4350; // "PMCP"
+
+// Bump this whenever the layout of any cached entry changes.
+const quint32 ProjectCache::version = 4;
+
+ProjectCache::ProjectCache(QString root)
+{
+    // Keep the cache out of the project tree, one file per project.
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QString id = QCryptographicHash::hash(QDir(root).absolutePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+    path = QString("%1/%2.cache").arg(dir).arg(id);
+}
+
+bool ProjectCache::load() {
+    QMutexLocker locker(&mutex);
+    entries.clear();
+    dirty = false;
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 fileMagic, fileVersion;
+    in >> fileMagic >> fileVersion;
+    if (fileMagic != magic || fileVersion != version) {
+        qDebug() << QString("Discarding project cache '%1' (version %2, expected %3)").arg(path).arg(fileVersion).arg(version);
+        return false;
+    }
+
+    // Entry data is stored once per distinct content (tilesets often share palettes
+    // and tile sheets), and entries refer to it by index.
+    quint32 numBlobs;
+    in >> numBlobs;
+    QList<QByteArray> blobs;
+    for (quint32 i = 0; i < numBlobs && in.status() == QDataStream::Ok; i++) {
+        QByteArray blob;
+        in >> blob;
+        blobs.append(blob);
+    }
+
+    quint32 numEntries;
+    in >> numEntries;
+    for (quint32 i = 0; i < numEntries && in.status() == QDataStream::Ok; i++) {
+        QString key;
+        quint32 numSources;
+        Entry entry;
+        in >> key >> numSources;
+        for (quint32 j = 0; j < numSources && in.status() == QDataStream::Ok; j++) {
+            SourceStamp stamp;
+            in >> stamp.path >> stamp.size >> stamp.mtime >> stamp.hash;
+            entry.sources.append(stamp);
+        }
+        quint32 blobIndex;
+        in >> blobIndex;
+        if (blobIndex >= quint32(blobs.length())) {
+            in.setStatus(QDataStream::ReadCorruptData);
+            break;
+        }
+        entry.data = blobs.value(blobIndex);
+        entries.insert(key, entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << QString("Project cache '%1' is corrupt. Discarding it.").arg(path);
+        entries.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ProjectCache::save() {
+    QMutexLocker locker(&mutex);
+    if (!dirty) {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << QString("Could not open project cache '%1' for writing: ").arg(path) + file.errorString();
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << magic << version;
+
+    // Entries whose sources were deleted can never be used again.
+    QList<QString> keys;
+    for (QString key : entries.keys()) {
+        bool exists = true;
+        for (SourceStamp stamp : entries[key].sources) {
+            if (!QFileInfo::exists(stamp.path)) {
+                exists = false;
+                break;
+            }
+        }
+        if (exists) {
+            keys.append(key);
+        }
+    }
+
+    QList<QByteArray> blobs;
+    QHash<QByteArray, quint32> blobIndices;
+    QList<quint32> entryBlobs;
+    for (QString key : keys) {
+        QByteArray data = entries[key].data;
+        QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Md5);
+        if (!blobIndices.contains(hash)) {
+            blobIndices.insert(hash, blobs.length());
+            blobs.append(data);
+        }
+        entryBlobs.append(blobIndices.value(hash));
+    }
+
+    out << quint32(blobs.length());
+    for (QByteArray blob : blobs) {
+        out << blob;
+    }
+    out << quint32(keys.length());
+    for (int i = 0; i < keys.length(); i++) {
+        QString key = keys.value(i);
+        Entry entry = entries.value(key);
+        out << key << quint32(entry.sources.length());
+        for (SourceStamp stamp : entry.sources) {
+            out << stamp.path << stamp.size << stamp.mtime << stamp.hash;
+        }
+        out << entryBlobs.value(i);
+    }
+
+    if (!file.commit()) {
+        qDebug() << QString("Failed to write project cache '%1': ").arg(path) + file.errorString();
+        return false;
+    }
+    dirty = false;
+    return true;
+}
+
+bool ProjectCache::get(QString key, QStringList sources, QByteArray *data) {
+    QMutexLocker locker(&mutex);
+    if (!entries.contains(key)) {
+        PerfCounters::add(PerfCounters::ProjectCacheMisses);
+        return false;
+    }
+
+    Entry *entry = &entries[key];
+    if (entry->sources.length() != sources.length()) {
+        PerfCounters::add(PerfCounters::ProjectCacheMisses);
+        return false;
+    }
+    for (int i = 0; i < sources.length(); i++) {
+        SourceStamp *stamp = &entry->sources[i];
+        if (stamp->path != sources.value(i) || !isUnchanged(stamp)) {
+            PerfCounters::add(PerfCounters::ProjectCacheMisses);
+            return false;
+        }
+    }
+
+    PerfCounters::add(PerfCounters::ProjectCacheHits);
+    *data = entry->data;
+    return true;
+}
+
+void ProjectCache::put(QString key, QStringList sources, QByteArray data) {
+    Entry entry;
+    for (QString source : sources) {
+        entry.sources.append(stampFile(source));
+    }
+    entry.data = data;
+
+    QMutexLocker locker(&mutex);
+    entries.insert(key, entry);
+    dirty = true;
+}
+
+void ProjectCache::remove(QString key) {
+    QMutexLocker locker(&mutex);
+    if (entries.remove(key)) {
+        dirty = true;
+    }
+}
+
+qint64 ProjectCache::bytes() {
+    QMutexLocker locker(&mutex);
+    qint64 bytes = 0;
+    for (Entry entry : entries.values()) {
+        bytes += entry.data.size();
+    }
+    return bytes;
+}
+
+ProjectCache::SourceStamp ProjectCache::stampFile(QString path) {
+    SourceStamp stamp;
+    stamp.path = path;
+    QFileInfo info(path);
+    if (info.exists()) {
+        stamp.size = info.size();
+        stamp.mtime = info.lastModified().toMSecsSinceEpoch();
+        stamp.hash = hashFile(path);
+    }
+    return stamp;
+}
+
+QByteArray ProjectCache::hashFile(QString path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(&file);
+    return hash.result();
+}
+
+bool ProjectCache::isUnchanged(SourceStamp *stamp) {
+    QFileInfo info(stamp->path);
+    if (!info.exists()) {
+        return stamp->size == -1;
+    }
+    if (info.size() != stamp->size) {
+        return false;
+    }
+    qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+    if (mtime == stamp->mtime) {
+        return true;
+    }
+
+    // Touched but possibly not modified (e.g. by a checkout). Fall back to the content hash,
+    // and remember the new timestamp so the file doesn't have to be hashed again.
+    if (hashFile(stamp->path) != stamp->hash) {
+        return false;
+    }
+    stamp->mtime = mtime;
+    dirty = true;
+    return true;
+}
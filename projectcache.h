@@ -0,0 +1,54 @@
+#ifndef PROJECTCACHE_H
+#define PROJECTCACHE_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMap>
+#include <QList>
+#include <QMutex>
+
+// On-disk cache of data derived from project files (parsed asm, C defines,
+// decoded tileset tiles). Each entry records the size, modification time
+// and hash of the source files it was built from, and is only handed out
+// while those sources are unchanged.
+class ProjectCache
+{
+public:
+    ProjectCache(QString root);
+    static const quint32 magic;
+    static const quint32 version;
+
+    QString path;
+
+    bool load();
+    bool save();
+    bool get(QString key, QStringList sources, QByteArray *data);
+    void put(QString key, QStringList sources, QByteArray data);
+    void remove(QString key);
+    qint64 bytes();
+
+private:
+    class SourceStamp {
+    public:
+        QString path;
+        qint64 size = -1;
+        qint64 mtime = -1;
+        QByteArray hash;
+    };
+    class Entry {
+    public:
+        QList<SourceStamp> sources;
+        QByteArray data;
+    };
+
+    static SourceStamp stampFile(QString path);
+    static QByteArray hashFile(QString path);
+    bool isUnchanged(SourceStamp *stamp);
+
+    QMap<QString, Entry> entries;
+    bool dirty = false;
+    QMutex mutex;
+};
+
+#endif // PROJECTCACHE_H
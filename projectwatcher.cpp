@@ -0,0 +1,74 @@
+#include "projectwatcher.h"
+#include "project.h"
+
+#include <QFile>
+
+ProjectWatcher::ProjectWatcher(Project *project, QObject *parent) : QObject(parent)
+{
+    this->project = project;
+    timer.setSingleShot(true);
+    timer.setInterval(300);
+    connect(&watcher, SIGNAL(fileChanged(QString)), this, SLOT(onFileChanged(QString)));
+    connect(&timer, SIGNAL(timeout()), this, SLOT(flush()));
+}
+
+void ProjectWatcher::watchMap(Map *map) {
+    for (QString path : project->getMapSourcePaths(map)) {
+        if (!mapsByPath[path].contains(map->name)) {
+            mapsByPath[path].append(map->name);
+        }
+        watch(path);
+    }
+}
+
+void ProjectWatcher::watchTileset(Tileset *tileset, QString label) {
+    for (QString path : tileset->sources) {
+        if (!tilesetsByPath[path].contains(label)) {
+            tilesetsByPath[path].append(label);
+        }
+        watch(path);
+    }
+}
+
+void ProjectWatcher::watch(QString path) {
+    if (!watcher.files().contains(path) && QFile::exists(path)) {
+        watcher.addPath(path);
+    }
+}
+
+void ProjectWatcher::onFileChanged(QString path) {
+    // Files replaced by renaming over them (like our own saves do) stop being watched.
+    watch(path);
+    changed.insert(path);
+    timer.start();
+}
+
+void ProjectWatcher::flush() {
+    QStringList map_names;
+    QStringList tileset_labels;
+    for (QString path : changed) {
+        // Skip the files pretmap wrote itself.
+        if (project->matchesSavedFile(path)) {
+            continue;
+        }
+        for (QString map_name : mapsByPath.value(path)) {
+            if (!map_names.contains(map_name)) {
+                map_names.append(map_name);
+            }
+        }
+        for (QString label : tilesetsByPath.value(path)) {
+            if (!tileset_labels.contains(label)) {
+                tileset_labels.append(label);
+            }
+        }
+    }
+    changed.clear();
+
+    // Tilesets first, so maps reloaded afterwards pick up the new ones.
+    if (!tileset_labels.isEmpty()) {
+        emit tilesetsChanged(tileset_labels);
+    }
+    if (!map_names.isEmpty()) {
+        emit mapsChanged(map_names);
+    }
+}
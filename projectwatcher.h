@@ -0,0 +1,47 @@
+#ifndef PROJECTWATCHER_H
+#define PROJECTWATCHER_H
+
+#include <QObject>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QMap>
+#include <QSet>
+#include <QStringList>
+
+class Project;
+class Map;
+class Tileset;
+
+// Watches the files behind every loaded map and tileset, and reports which of
+// them were changed outside of pretmap (by a build, a git checkout, another editor...).
+// Changes are collected for a moment first, so a checkout touching many files
+// is reported once.
+class ProjectWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ProjectWatcher(Project *project, QObject *parent = 0);
+
+    void watchMap(Map *map);
+    void watchTileset(Tileset *tileset, QString label);
+
+signals:
+    void mapsChanged(QStringList map_names);
+    void tilesetsChanged(QStringList tileset_labels);
+
+private slots:
+    void onFileChanged(QString path);
+    void flush();
+
+private:
+    void watch(QString path);
+
+    Project *project = NULL;
+    QFileSystemWatcher watcher;
+    QTimer timer;
+    QSet<QString> changed;
+    QMap<QString, QStringList> mapsByPath;
+    QMap<QString, QStringList> tilesetsByPath;
+};
+
+#endif // PROJECTWATCHER_H
@@ -0,0 +1,332 @@
+#include "savetransaction.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QFuture>
+#include <QtConcurrent/QtConcurrentRun>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#endif
+
+SaveTransaction::SaveTransaction(QString root)
+{
+    this->root = root;
+}
+
+void SaveTransaction::write(QString path, QByteArray data) {
+    removals.removeAll(path);
+    writes.insert(path, data);
+}
+
+void SaveTransaction::remove(QString path) {
+    writes.remove(path);
+    if (!removals.contains(path)) {
+        removals.append(path);
+    }
+}
+
+bool SaveTransaction::staged(QString path, QByteArray *data) {
+    if (!writes.contains(path)) {
+        return false;
+    }
+    *data = writes.value(path);
+    return true;
+}
+
+bool SaveTransaction::commit(std::function<void(int, int)> progress) {
+    QStringList paths = writes.keys();
+    int total = paths.length();
+    errorString = QString();
+
+    // Directories are only created now, so a save that fails doesn't leave them behind.
+    for (QString path : paths) {
+        if (!makeDirectory(QFileInfo(path).absolutePath())) {
+            errorString = QString("Could not create the directory for '%1'").arg(path);
+            removeCreatedDirectories();
+            return false;
+        }
+    }
+
+    // Stage every file next to its destination. The files are independent, so they're written in parallel.
+    QList<QFuture<bool>> futures;
+    for (QString path : paths) {
+        QByteArray data = writes.value(path);
+        futures.append(QtConcurrent::run([path, data]() {
+            return stageFile(path, data);
+        }));
+    }
+    bool ok = true;
+    for (int i = 0; i < futures.length(); i++) {
+        if (!futures[i].result() && ok) {
+            ok = false;
+            errorString = QString("Could not write '%1'").arg(paths.value(i));
+        }
+        if (progress) {
+            progress(i + 1, total);
+        }
+    }
+
+    // Note which files are about to be replaced before touching any of them,
+    // so a save that's interrupted from here on can be undone by recover().
+    QStringList touched = paths + removals;
+    QStringList originals;
+    for (QString path : touched) {
+        if (QFile::exists(path)) {
+            originals.append(path);
+        }
+    }
+    if (ok && !writeLog("installing", touched, originals)) {
+        ok = false;
+        errorString = QString("Could not write '%1'").arg(logPath(root));
+    }
+    if (!ok) {
+        for (QString path : paths) {
+            QFile::remove(tempPath(path));
+        }
+        removeCreatedDirectories();
+        return false;
+    }
+
+    // Originals are kept as backups until the end, so the whole save can still be undone if any step fails.
+    // The staged files are renamed straight over their destinations, so each path exists at every moment.
+    QStringList backed_up;
+    QStringList installed;
+    for (QString path : paths) {
+        if (originals.contains(path)) {
+            if (!backUpFile(path)) {
+                ok = false;
+                errorString = QString("Could not back up '%1'").arg(path);
+                break;
+            }
+            backed_up.append(path);
+        }
+        if (!replaceFile(tempPath(path), path)) {
+            ok = false;
+            errorString = QString("Could not replace '%1'").arg(path);
+            break;
+        }
+        installed.append(path);
+    }
+    if (ok) {
+        for (QString path : removals) {
+            if (!originals.contains(path)) {
+                continue;
+            }
+            if (!replaceFile(path, backupPath(path))) {
+                ok = false;
+                errorString = QString("Could not delete '%1'").arg(path);
+                break;
+            }
+            backed_up.append(path);
+        }
+    }
+    if (ok && !syncDirectories(touched)) {
+        ok = false;
+        errorString = "Could not sync the saved files to disk";
+    }
+
+    if (!ok) {
+        for (QString path : installed) {
+            if (!backed_up.contains(path)) {
+                QFile::remove(path);
+            }
+        }
+        for (QString path : backed_up) {
+            replaceFile(backupPath(path), path);
+        }
+        for (QString path : paths) {
+            QFile::remove(tempPath(path));
+        }
+        syncDirectories(touched);
+        QFile::remove(logPath(root));
+        removeCreatedDirectories();
+        return false;
+    }
+
+    // Everything is in place. From here on an interrupted save is finished, not undone.
+    if (!writeLog("committed", touched, originals)) {
+        qDebug() << QString("Could not mark the save as finished in '%1'").arg(logPath(root));
+    }
+    for (QString path : backed_up) {
+        QFile::remove(backupPath(path));
+    }
+    QFile::remove(logPath(root));
+    writes.clear();
+    removals.clear();
+    createdDirectories.clear();
+    return true;
+}
+
+// Creates dir and any missing parents, remembering each one that was created.
+bool SaveTransaction::makeDirectory(QString dir) {
+    QFileInfo info(dir);
+    if (info.isDir()) {
+        return true;
+    }
+    QString parent = info.absolutePath();
+    if (parent != dir && !makeDirectory(parent)) {
+        return false;
+    }
+    if (!QDir().mkdir(dir)) {
+        return false;
+    }
+    createdDirectories.append(dir);
+    return true;
+}
+
+// Innermost first. Only empty directories can be removed, so nothing else is lost.
+void SaveTransaction::removeCreatedDirectories() {
+    for (int i = createdDirectories.length() - 1; i >= 0; i--) {
+        QDir().rmdir(createdDirectories.value(i));
+    }
+    createdDirectories.clear();
+}
+
+// Cleans up after a save that didn't finish, e.g. because pretmap crashed or the machine lost power.
+// A save that was still replacing files is rolled back, so the project is as it was before that save.
+// Returns true if a save was rolled back.
+bool SaveTransaction::recover(QString root) {
+    QFile file(logPath(root));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QStringList lines = QString::fromUtf8(file.readAll()).split('\n', QString::SkipEmptyParts);
+    file.close();
+
+    bool roll_back = lines.value(0) != "committed";
+    QStringList paths;
+    for (QString line : lines.mid(1)) {
+        bool had_original = line.startsWith("1\t");
+        QString path = line.mid(2);
+        paths.append(path);
+        if (roll_back) {
+            if (had_original) {
+                if (QFile::exists(backupPath(path))) {
+                    replaceFile(backupPath(path), path);
+                }
+            } else {
+                QFile::remove(path);
+            }
+        } else {
+            QFile::remove(backupPath(path));
+        }
+        QFile::remove(tempPath(path));
+    }
+    syncDirectories(paths);
+    QFile::remove(logPath(root));
+    if (roll_back) {
+        qDebug() << QString("Rolled back an unfinished save of %1 file(s)").arg(paths.length());
+    }
+    return roll_back;
+}
+
+void SaveTransaction::rollback() {
+    writes.clear();
+    removals.clear();
+}
+
+bool SaveTransaction::stageFile(QString path, QByteArray data) {
+    QFile file(tempPath(path));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << QString("Could not open '%1' for writing: ").arg(file.fileName()) + file.errorString();
+        return false;
+    }
+    bool ok = file.write(data) == data.size() && file.flush();
+#ifdef Q_OS_WIN
+    ok = ok && _commit(file.handle()) == 0;
+#else
+    ok = ok && fsync(file.handle()) == 0;
+#endif
+    file.close();
+    if (!ok) {
+        qDebug() << QString("Failed to write '%1': ").arg(file.fileName()) + file.errorString();
+        file.remove();
+    }
+    return ok;
+}
+
+QString SaveTransaction::tempPath(QString path) {
+    return path + ".pretmap-tmp";
+}
+
+QString SaveTransaction::backupPath(QString path) {
+    return path + ".pretmap-bak";
+}
+
+QString SaveTransaction::logPath(QString root) {
+    return root + "/.pretmap-save";
+}
+
+// Renames source to destination, replacing destination in one step if it exists.
+bool SaveTransaction::replaceFile(QString source, QString destination) {
+#ifdef Q_OS_WIN
+    return MoveFileExW((LPCWSTR)source.utf16(), (LPCWSTR)destination.utf16(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return ::rename(QFile::encodeName(source).constData(), QFile::encodeName(destination).constData()) == 0;
+#endif
+}
+
+// Keeps a copy of path's current contents at its backup path, without moving path.
+// A hard link is enough, since path is only ever replaced, never written in place.
+bool SaveTransaction::backUpFile(QString path) {
+    QString backup = backupPath(path);
+    QFile::remove(backup);
+#ifdef Q_OS_WIN
+    if (CreateHardLinkW((LPCWSTR)backup.utf16(), (LPCWSTR)path.utf16(), NULL)) {
+        return true;
+    }
+#else
+    if (::link(QFile::encodeName(path).constData(), QFile::encodeName(backup).constData()) == 0) {
+        return true;
+    }
+#endif
+    return QFile::copy(path, backup);
+}
+
+// Renames are only durable once the directories holding them are synced.
+bool SaveTransaction::syncDirectories(QStringList paths) {
+#ifdef Q_OS_WIN
+    // MoveFileEx already waited for the renames to be written.
+    return true;
+#else
+    QSet<QString> dirs;
+    for (QString path : paths) {
+        dirs.insert(QFileInfo(path).absolutePath());
+    }
+    bool ok = true;
+    for (QString dir : dirs) {
+        int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY);
+        if (fd < 0) {
+            ok = false;
+            continue;
+        }
+        ok = fsync(fd) == 0 && ok;
+        ::close(fd);
+    }
+    return ok;
+#endif
+}
+
+// The log lists every file the save touches, and whether it existed before the save.
+bool SaveTransaction::writeLog(QString state, QStringList paths, QStringList originals) {
+    QByteArray data = state.toUtf8() + "\n";
+    for (QString path : paths) {
+        data += (originals.contains(path) ? "1\t" : "0\t") + path.toUtf8() + "\n";
+    }
+    QSaveFile file(logPath(root));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(data);
+    return file.commit();
+}
@@ -0,0 +1,50 @@
+#ifndef SAVETRANSACTION_H
+#define SAVETRANSACTION_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QMap>
+#include <functional>
+
+// Collects the files written during a save and commits them all at once.
+// New contents are staged to temporary files in parallel and synced to disk
+// before any original is replaced, and if anything fails every original is
+// put back, so a failed save never leaves a partially written project.
+// Each file is replaced with a single atomic rename, so it always exists on
+// disk, and a log in the project root lets a save that was cut short be
+// rolled back the next time the project is opened (see recover()).
+class SaveTransaction
+{
+public:
+    SaveTransaction(QString root);
+    static bool recover(QString root);
+
+    void write(QString path, QByteArray data);
+    void remove(QString path);
+    bool staged(QString path, QByteArray *data);
+    bool commit(std::function<void(int, int)> progress = nullptr);
+    void rollback();
+
+    QString errorString;
+
+private:
+    static bool stageFile(QString path, QByteArray data);
+    static QString tempPath(QString path);
+    static QString backupPath(QString path);
+    static QString logPath(QString root);
+    static bool replaceFile(QString source, QString destination);
+    static bool backUpFile(QString path);
+    static bool syncDirectories(QStringList paths);
+    bool makeDirectory(QString dir);
+    void removeCreatedDirectories();
+    bool writeLog(QString state, QStringList paths, QStringList originals);
+
+    QString root;
+    QMap<QString, QByteArray> writes;
+    QStringList removals;
+    // Made for files in directories that didn't exist yet, like a new map's.
+    QStringList createdDirectories;
+};
+
+#endif // SAVETRANSACTION_H
@@ -0,0 +1,63 @@
+#include "textwriter.h"
+
+#include <string.h>
+
+TextWriter::TextWriter(int reserve)
+{
+    data.reserve(reserve);
+}
+
+TextWriter& TextWriter::operator<<(const char *text) {
+    data.append(text, int(strlen(text)));
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(const QString &text) {
+    // Almost everything written is ASCII, which can be copied over without encoding.
+    int start = data.size();
+    int length = text.length();
+    const QChar *chars = text.constData();
+    data.resize(start + length);
+    char *out = data.data() + start;
+    for (int i = 0; i < length; i++) {
+        ushort c = chars[i].unicode();
+        if (c >= 0x80) {
+            data.resize(start + i);
+            data.append(text.mid(i).toUtf8());
+            break;
+        }
+        out[i] = char(c);
+    }
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(char c) {
+    data.append(c);
+    return *this;
+}
+
+TextWriter& TextWriter::operator<<(int value) {
+    char buffer[12];
+    int i = sizeof(buffer);
+    unsigned int magnitude = value < 0 ? 0u - unsigned(value) : unsigned(value);
+    do {
+        buffer[--i] = char('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) {
+        buffer[--i] = '-';
+    }
+    data.append(buffer + i, int(sizeof(buffer)) - i);
+    return *this;
+}
+
+TextWriter& TextWriter::fill(char c, int count) {
+    if (count > 0) {
+        data.append(QByteArray(count, c));
+    }
+    return *this;
+}
+
+TextWriter& TextWriter::label(const QString &label) {
+    return *this << label << "::\n";
+}
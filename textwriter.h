@@ -0,0 +1,26 @@
+#ifndef TEXTWRITER_H
+#define TEXTWRITER_H
+
+#include <QString>
+#include <QByteArray>
+
+// Builds the text of a generated asm or C file straight into a UTF-8 buffer,
+// instead of formatting and concatenating temporary QStrings.
+class TextWriter
+{
+public:
+    TextWriter(int reserve = 4096);
+
+    TextWriter& operator<<(const char *text);
+    TextWriter& operator<<(const QString &text);
+    TextWriter& operator<<(char c);
+    TextWriter& operator<<(int value);
+    TextWriter& fill(char c, int count);
+
+    // "<label>::\n"
+    TextWriter& label(const QString &label);
+
+    QByteArray data;
+};
+
+#endif // TEXTWRITER_H
@@ -1,4 +1,5 @@
 #include "tileset.h"
+#include "perfcounters.h"
 
 #include <QPainter>
 #include <QImage>
@@ -9,13 +10,91 @@ Tileset::Tileset()
 
 }
 
+// The metatiles themselves are interned and shared with other tilesets, so only the lists are deleted.
+Tileset::~Tileset()
+{
+    delete metatiles;
+    delete palettes;
+}
+
+int Tileset::numTiles() {
+    return tiles.length() / 64;
+}
+
+// Returns the 64 color indices of a tile, or NULL if the tile doesn't exist.
+const uchar* Tileset::getTile(int index) {
+    if (index < 0 || index >= numTiles()) {
+        return NULL;
+    }
+    return reinterpret_cast<const uchar*>(tiles.constData()) + index * 64;
+}
+
+QByteArray Tileset::decode4bpp(QByteArray data) {
+    QByteArray tiles((data.length() / 32) * 64, 0);
+    uchar *dest = reinterpret_cast<uchar*>(tiles.data());
+    for (int i = 0; i < tiles.length() / 2; i++) {
+        uchar byte = data.at(i);
+        dest[i * 2] = byte & 0xf;
+        dest[i * 2 + 1] = byte >> 4;
+    }
+    return tiles;
+}
+
+// Pixels with an index above 15 can't be drawn with a 16-color palette. They're given
+// index 0, so they're drawn in the palette's first color, and counted in invalidPixels
+// so the caller can report them.
+QByteArray Tileset::decodeTileImage(QImage image, int *invalidPixels) {
+    if (image.format() != QImage::Format_Indexed8) {
+        image = image.convertToFormat(QImage::Format_Indexed8);
+    }
+    int tiles_wide = image.width() / 8;
+    int tiles_tall = image.height() / 8;
+    QByteArray tiles(tiles_wide * tiles_tall * 64, 0);
+    uchar *dest = reinterpret_cast<uchar*>(tiles.data());
+    int invalid = 0;
+    for (int y = 0; y < tiles_tall; y++)
+    for (int x = 0; x < tiles_wide; x++)
+    for (int py = 0; py < 8; py++) {
+        const uchar *src = image.constScanLine(y * 8 + py) + x * 8;
+        for (int px = 0; px < 8; px++) {
+            if (src[px] > 0xf) {
+                invalid++;
+                *dest++ = 0;
+            } else {
+                *dest++ = src[px];
+            }
+        }
+    }
+    if (invalidPixels) {
+        *invalidPixels = invalid;
+    }
+    return tiles;
+}
+
+MemoryUsage Tileset::memoryUsage() {
+    MemoryUsage usage;
+    usage.add("tileset tiles", tiles.size());
+    if (metatiles) {
+        for (Metatile *metatile : *metatiles) {
+            usage.add("tileset metatiles", sizeof(Metatile) + (metatile->tiles ? metatile->tiles->length() * sizeof(Tile) : 0));
+        }
+    }
+    if (palettes) {
+        for (QList<QRgb> palette : *palettes) {
+            usage.add("tileset palettes", palette.length() * sizeof(QRgb));
+        }
+    }
+    return usage;
+}
+
 Metatile::Metatile()
 {
     tiles = new QList<Tile>;
 }
 
 QImage Metatile::getMetatileImage(int tile, Tileset *primaryTileset, Tileset *secondaryTileset) {
-    QImage metatile_image(16, 16, QImage::Format_RGBA8888);
+    PerfCounters::add(PerfCounters::MetatilesRendered);
+    QImage metatile_image(16, 16, QImage::Format_ARGB32);
 
     Metatile* metatile = Metatile::getMetatile(tile, primaryTileset, secondaryTileset);
     if (!metatile || !metatile->tiles) {
@@ -30,13 +109,13 @@ QImage Metatile::getMetatileImage(int tile, Tileset *primaryTileset, Tileset *se
     }
     QList<QList<QRgb>> palettes = Metatile::getBlockPalettes(primaryTileset, secondaryTileset);
 
-    QPainter metatile_painter(&metatile_image);
+    metatile_image.fill(0);
     for (int layer = 0; layer < 2; layer++)
     for (int y = 0; y < 2; y++)
     for (int x = 0; x < 2; x++) {
         Tile tile_ = metatile->tiles->value((y * 2) + x + (layer * 4));
-        QImage tile_image = Metatile::getMetatileTile(tile_.tile, primaryTileset, secondaryTileset);
-        if (tile_image.isNull()) {
+        const uchar *tile_pixels = Metatile::getMetatileTile(tile_.tile, primaryTileset, secondaryTileset);
+        if (!tile_pixels) {
             // Some metatiles specify tiles that are outside the valid range.
             // These are treated as completely transparent, so they can be skipped without
             // being drawn.
@@ -44,26 +123,32 @@ QImage Metatile::getMetatileImage(int tile, Tileset *primaryTileset, Tileset *se
         }
 
         // Colorize the metatile tiles with its palette.
+        QRgb colors[16];
         if (tile_.palette < palettes.length()) {
             QList<QRgb> palette = palettes.value(tile_.palette);
-            for (int j = 0; j < palette.length(); j++) {
-                tile_image.setColor(j, palette.value(j));
+            for (int j = 0; j < 16; j++) {
+                colors[j] = palette.value(j);
             }
         } else {
             qDebug() << "Tile is referring to invalid palette number: " << tile_.palette;
+            for (int j = 0; j < 16; j++) {
+                colors[j] = qRgb(j * 17, j * 17, j * 17);
+            }
         }
 
-        // The top layer of the metatile has its last color displayed at transparent.
-        if (layer > 0) {
-            QColor color(tile_image.color(15));
-            color.setAlpha(0);
-            tile_image.setColor(15, color.rgba());
+        for (int py = 0; py < 8; py++) {
+            QRgb *line = reinterpret_cast<QRgb*>(metatile_image.scanLine(y * 8 + py)) + x * 8;
+            const uchar *src = tile_pixels + (tile_.yflip == 1 ? 7 - py : py) * 8;
+            for (int px = 0; px < 8; px++) {
+                uchar index = src[tile_.xflip == 1 ? 7 - px : px];
+                // The top layer of the metatile has its last color displayed at transparent.
+                if (layer > 0 && index == 15) {
+                    continue;
+                }
+                line[px] = colors[index];
+            }
         }
-
-        QPoint origin = QPoint(x*8, y*8);
-        metatile_painter.drawImage(origin, tile_image.mirrored(tile_.xflip == 1, tile_.yflip == 1));
     }
-    metatile_painter.end();
 
     return metatile_image;
 }
@@ -78,13 +163,13 @@ Metatile* Metatile::getMetatile(int index, Tileset *primaryTileset, Tileset *sec
     return metatile;
 }
 
-QImage Metatile::getMetatileTile(int tile, Tileset *primaryTileset, Tileset *secondaryTileset) {
+const uchar* Metatile::getMetatileTile(int tile, Tileset *primaryTileset, Tileset *secondaryTileset) {
     Tileset *tileset = Metatile::getBlockTileset(tile, primaryTileset, secondaryTileset);
     int local_index = Metatile::getBlockIndex(tile);
-    if (!tileset || !tileset->tiles) {
-        return QImage();
+    if (!tileset) {
+        return NULL;
     }
-    return tileset->tiles->value(local_index, QImage());
+    return tileset->getTile(local_index);
 }
 
 Tileset* Metatile::getBlockTileset(int metatile_index, Tileset *primaryTileset, Tileset *secondaryTileset) {
@@ -2,7 +2,9 @@
 #define TILESET_H
 
 #include "tile.h"
+#include "memoryusage.h"
 #include <QImage>
+#include <QByteArray>
 
 class Metatile;
 
@@ -10,6 +12,7 @@ class Tileset
 {
 public:
     Tileset();
+    ~Tileset();
 public:
     QString name;
     QString is_compressed;
@@ -21,9 +24,22 @@ public:
     QString callback_label;
     QString metatile_attrs_label;
 
-    QList<QImage> *tiles = NULL;
+    // Color indices of every 8x8 tile, one byte per pixel and 64 bytes per tile.
+    QByteArray tiles;
     QList<Metatile*> *metatiles = NULL;
     QList<QList<QRgb>> *palettes = NULL;
+
+    // The files the tileset was read from.
+    QStringList sources;
+
+    int numTiles();
+    const uchar* getTile(int index);
+
+    // Tileset data is interned (see AssetPool), so this counts data that other tilesets may share.
+    MemoryUsage memoryUsage();
+
+    static QByteArray decode4bpp(QByteArray data);
+    static QByteArray decodeTileImage(QImage image, int *invalidPixels = NULL);
 };
 
 class Metatile
@@ -36,7 +52,7 @@ public:
 
     static QImage getMetatileImage(int, Tileset*, Tileset*);
     static Metatile* getMetatile(int, Tileset*, Tileset*);
-    static QImage getMetatileTile(int, Tileset*, Tileset*);
+    static const uchar* getMetatileTile(int, Tileset*, Tileset*);
     static Tileset* getBlockTileset(int, Tileset*, Tileset*);
     static int getBlockIndex(int);
     static QList<QList<QRgb>> getBlockPalettes(Tileset*, Tileset*);
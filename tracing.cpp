@@ -0,0 +1,118 @@
+#include "tracing.h"
+
+#include <QDebug>
+#include <QThread>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+QAtomicInt Tracing::enabled;
+QMutex Tracing::mutex;
+QList<Tracing::Event> Tracing::events;
+int Tracing::dropped = 0;
+QElapsedTimer Tracing::clock;
+quintptr Tracing::mainThread = 0;
+
+void Tracing::setEnabled(bool enable) {
+    QMutexLocker locker(&mutex);
+    if (enable && !clock.isValid()) {
+        clock.start();
+        mainThread = quintptr(QThread::currentThreadId());
+    }
+    enabled.store(enable);
+}
+
+void Tracing::clear() {
+    QMutexLocker locker(&mutex);
+    events.clear();
+    dropped = 0;
+}
+
+int Tracing::eventCount() {
+    QMutexLocker locker(&mutex);
+    return events.length();
+}
+
+// Microseconds, which is what the trace format uses.
+qint64 Tracing::now() {
+    return clock.nsecsElapsed() / 1000;
+}
+
+void Tracing::record(const char *name, const char *category, qint64 start, qint64 end) {
+    Event event;
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.duration = end - start;
+    event.thread = quintptr(QThread::currentThreadId());
+
+    QMutexLocker locker(&mutex);
+    if (events.length() >= maxEvents) {
+        dropped++;
+        return;
+    }
+    events.append(event);
+}
+
+bool Tracing::save(QString path) {
+    QList<Event> recorded;
+    int recordedDropped;
+    {
+        QMutexLocker locker(&mutex);
+        recorded = events;
+        recordedDropped = dropped;
+    }
+
+    // Thread ids are opaque handles. Number them in order of appearance, main thread first.
+    QMap<quintptr, int> threads;
+    threads.insert(mainThread, 1);
+    for (Event event : recorded) {
+        if (!threads.contains(event.thread)) {
+            threads.insert(event.thread, threads.size() + 1);
+        }
+    }
+
+    QJsonArray traceEvents;
+    for (quintptr thread : threads.keys()) {
+        QJsonObject args;
+        args["name"] = thread == mainThread ? QString("main") : QString("worker %1").arg(threads.value(thread) - 1);
+        QJsonObject metadata;
+        metadata["name"] = "thread_name";
+        metadata["ph"] = "M";
+        metadata["pid"] = 1;
+        metadata["tid"] = threads.value(thread);
+        metadata["args"] = args;
+        traceEvents.append(metadata);
+    }
+    for (Event event : recorded) {
+        QJsonObject object;
+        object["name"] = event.name;
+        object["cat"] = event.category;
+        object["ph"] = "X";
+        object["ts"] = double(event.start);
+        object["dur"] = double(event.duration);
+        object["pid"] = 1;
+        object["tid"] = threads.value(event.thread);
+        traceEvents.append(object);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << QString("Could not open '%1' for writing: ").arg(path) + file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qDebug() << QString("Failed to write trace '%1': ").arg(path) + file.errorString();
+        return false;
+    }
+    if (recordedDropped) {
+        qDebug() << QString("Trace '%1' is missing %2 events recorded after the first %3").arg(path).arg(recordedDropped).arg(maxEvents);
+    }
+    return true;
+}
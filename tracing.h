@@ -0,0 +1,77 @@
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+// Records how long hot paths take, for saving as a Chrome trace
+// (chrome://tracing, Perfetto). Recording is off unless turned on,
+// and a zone costs one atomic load while it's off.
+class Tracing
+{
+public:
+    static bool isEnabled() {
+        return enabled.load();
+    }
+    static void setEnabled(bool enable);
+    static void clear();
+    static int eventCount();
+    static bool save(QString path);
+
+    static qint64 now();
+    static void record(const char *name, const char *category, qint64 start, qint64 end);
+
+    // Beyond this the oldest events are kept and new ones dropped, so a forgotten recording can't eat all memory.
+    static const int maxEvents = 1 << 20;
+
+private:
+    class Event {
+    public:
+        const char *name;
+        const char *category;
+        qint64 start;
+        qint64 duration;
+        quintptr thread;
+    };
+
+    static QAtomicInt enabled;
+    static QMutex mutex;
+    static QList<Event> events;
+    static int dropped;
+    static QElapsedTimer clock;
+    static quintptr mainThread;
+};
+
+// Records the time from construction to the end of the enclosing scope.
+// Names and categories must be string literals, since only the pointers are kept.
+class TraceZone
+{
+public:
+    TraceZone(const char *name, const char *category)
+        : name(name), category(category), start(Tracing::isEnabled() ? Tracing::now() : -1) {}
+    ~TraceZone() {
+        if (start >= 0) {
+            Tracing::record(name, category, start, Tracing::now());
+        }
+    }
+
+private:
+    const char *name;
+    const char *category;
+    qint64 start;
+};
+
+// Build with DEFINES += PRETMAP_NO_TRACING to compile the zones out entirely.
+#ifdef PRETMAP_NO_TRACING
+#define TRACE_ZONE(name, category)
+#else
+#define TRACE_ZONE_VARIABLE_(line) trace_zone_##line
+#define TRACE_ZONE_VARIABLE(line) TRACE_ZONE_VARIABLE_(line)
+#define TRACE_ZONE(name, category) TraceZone TRACE_ZONE_VARIABLE(__LINE__)(name, category)
+#endif
+
+#endif // TRACING_H
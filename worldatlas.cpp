@@ -0,0 +1,279 @@
+#include "worldatlas.h"
+#include "tileset.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QPainter>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QtConcurrent/QtConcurrentMap>
+
+const int WorldAtlas::tileSize = 256;
+
+WorldAtlas::WorldAtlas(Project *project)
+{
+    this->project = project;
+}
+
+void WorldAtlas::build(QString start_map) {
+    placements.clear();
+    if (!start_map.isEmpty()) {
+        placements = placeMaps(start_map);
+    } else {
+        // Only maps with connections can be part of a group bigger than one map,
+        // so the others are never loaded. The search stops once no group that's
+        // left could be bigger than the biggest found.
+        QStringList candidates = project->mapsWithConnections;
+        if (candidates.isEmpty() && !project->mapNames->isEmpty()) {
+            candidates.append(project->mapNames->first());
+        }
+        QSet<QString> placed;
+        int unplaced = candidates.length();
+        for (QString map_name : candidates) {
+            if (placed.contains(map_name)) {
+                continue;
+            }
+            if (placements.length() >= unplaced) {
+                break;
+            }
+            QList<Placement> group = placeMaps(map_name);
+            for (Placement placement : group) {
+                if (!placed.contains(placement.map_name) && candidates.contains(placement.map_name)) {
+                    unplaced--;
+                }
+                placed.insert(placement.map_name);
+            }
+            if (group.length() > placements.length()) {
+                placements = group;
+            }
+        }
+    }
+
+    QRect metatiles;
+    for (Placement placement : placements) {
+        metatiles = metatiles.united(placement.rect);
+    }
+    bounds = QRect(metatiles.x() * 16, metatiles.y() * 16, metatiles.width() * 16, metatiles.height() * 16);
+}
+
+// Breadth-first walk of the connection graph. The first path to reach a map decides
+// where it goes. Dive and emerge connections lead to other layers, so they're not followed.
+QList<WorldAtlas::Placement> WorldAtlas::placeMaps(QString start_map) {
+    QList<Placement> result;
+    Map *start = project->getMap(start_map);
+    if (!start || !start->layout) {
+        return result;
+    }
+
+    QMap<QString, QPoint> positions;
+    QList<QString> queue;
+    positions.insert(start_map, QPoint(0, 0));
+    queue.append(start_map);
+    while (!queue.isEmpty()) {
+        QString map_name = queue.takeFirst();
+        Map *map = project->getMap(map_name);
+        QPoint position = positions.value(map_name);
+
+        Placement placement;
+        placement.map_name = map_name;
+        placement.rect = QRect(position, QSize(map->getWidth(), map->getHeight()));
+        if (map->layout->blockdata && map->layout->blockdata->blocks) {
+            placement.blocks = *map->layout->blockdata->blocks;
+        }
+        placement.tileset_primary = map->layout->tileset_primary;
+        placement.tileset_secondary = map->layout->tileset_secondary;
+        result.append(placement);
+
+        for (Connection *connection : map->connections) {
+            if (positions.contains(connection->map_name)) {
+                continue;
+            }
+            Map *connected = project->getMap(connection->map_name);
+            if (!connected || !connected->layout) {
+                continue;
+            }
+            int offset = connection->offset.toInt(nullptr, 0);
+            QPoint connected_position;
+            if (connection->direction == "up") {
+                connected_position = QPoint(position.x() + offset, position.y() - connected->getHeight());
+            } else if (connection->direction == "down") {
+                connected_position = QPoint(position.x() + offset, position.y() + map->getHeight());
+            } else if (connection->direction == "left") {
+                connected_position = QPoint(position.x() - connected->getWidth(), position.y() + offset);
+            } else if (connection->direction == "right") {
+                connected_position = QPoint(position.x() + map->getWidth(), position.y() + offset);
+            } else {
+                continue;
+            }
+            positions.insert(connection->map_name, connected_position);
+            queue.append(connection->map_name);
+        }
+    }
+    return result;
+}
+
+// Points the placements at reread tilesets. Nothing may be rendering while this runs.
+void WorldAtlas::replaceTilesets(QMap<Tileset*, Tileset*> tilesets) {
+    for (int i = 0; i < placements.length(); i++) {
+        Placement &placement = placements[i];
+        placement.tileset_primary = tilesets.value(placement.tileset_primary, placement.tileset_primary);
+        placement.tileset_secondary = tilesets.value(placement.tileset_secondary, placement.tileset_secondary);
+    }
+}
+
+int WorldAtlas::maxLevel() {
+    int level = 0;
+    while ((tileSize << level) < qMax(bounds.width(), bounds.height())) {
+        level++;
+    }
+    return level;
+}
+
+QRect WorldAtlas::tileRect(int level, int x, int y) {
+    int size = tileSize << level;
+    return QRect(bounds.x() + x * size, bounds.y() + y * size, size, size);
+}
+
+QImage WorldAtlas::renderTile(int level, int x, int y) {
+    QImage image(tileSize, tileSize, QImage::Format_ARGB32);
+    image.fill(0);
+
+    QRect rect = tileRect(level, x, y);
+    qreal scale = 1.0 / (1 << level);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, level > 0);
+    painter.scale(scale, scale);
+    painter.translate(-rect.topLeft());
+
+    for (Placement placement : placements) {
+        QRect pixels(placement.rect.topLeft() * 16, placement.rect.size() * 16);
+        QRect visible = pixels.intersected(rect);
+        if (visible.isEmpty()) {
+            continue;
+        }
+
+        // Maps reuse the same few metatiles a lot, so each one is only drawn once per map.
+        QHash<int, QImage> metatile_images;
+        int width = placement.rect.width();
+        int first_x = (visible.left() - pixels.left()) / 16;
+        int last_x = (visible.right() - pixels.left()) / 16;
+        int first_y = (visible.top() - pixels.top()) / 16;
+        int last_y = (visible.bottom() - pixels.top()) / 16;
+        for (int my = first_y; my <= last_y; my++)
+        for (int mx = first_x; mx <= last_x; mx++) {
+            int i = my * width + mx;
+            if (i >= placement.blocks.length()) {
+                continue;
+            }
+            int tile = placement.blocks.at(i).tile;
+            if (!metatile_images.contains(tile)) {
+                metatile_images.insert(tile, Metatile::getMetatileImage(tile, placement.tileset_primary, placement.tileset_secondary));
+            }
+            painter.drawImage(QPoint(pixels.x() + mx * 16, pixels.y() + my * 16), metatile_images.value(tile));
+        }
+    }
+    painter.end();
+    return image;
+}
+
+bool WorldAtlas::exportTiles(QString dir, std::function<void(int, int)> progress) {
+    if (placements.isEmpty()) {
+        return false;
+    }
+    int max_level = maxLevel();
+
+    // Only the full resolution tiles are rendered. Each level after that is scaled down
+    // from the one before it, reading the tiles back from disk so the world never has
+    // to fit in memory.
+    QList<QPoint> tiles;
+    QSet<quint64> seen;
+    for (Placement placement : placements) {
+        QRect pixels(placement.rect.topLeft() * 16, placement.rect.size() * 16);
+        for (int y = (pixels.top() - bounds.top()) / tileSize; y <= (pixels.bottom() - bounds.top()) / tileSize; y++)
+        for (int x = (pixels.left() - bounds.left()) / tileSize; x <= (pixels.right() - bounds.left()) / tileSize; x++) {
+            quint64 key = (quint64(x) << 32) | quint32(y);
+            if (!seen.contains(key)) {
+                seen.insert(key);
+                tiles.append(QPoint(x, y));
+            }
+        }
+    }
+
+    for (int level = 0; level <= max_level; level++) {
+        QString level_dir = QString("%1/%2").arg(dir).arg(level);
+        if (!QDir().mkpath(level_dir)) {
+            qDebug() << QString("Could not create '%1'").arg(level_dir);
+            return false;
+        }
+
+        std::function<bool(QPoint)> write = [this, dir, level, level_dir](QPoint tile) {
+            QImage image;
+            if (level == 0) {
+                image = renderTile(0, tile.x(), tile.y());
+            } else {
+                image = QImage(tileSize, tileSize, QImage::Format_ARGB32);
+                image.fill(0);
+                QPainter painter(&image);
+                painter.setRenderHint(QPainter::SmoothPixmapTransform);
+                for (int dy = 0; dy < 2; dy++)
+                for (int dx = 0; dx < 2; dx++) {
+                    QImage child(QString("%1/%2/%3_%4.png").arg(dir).arg(level - 1)
+                                 .arg(tile.x() * 2 + dx).arg(tile.y() * 2 + dy));
+                    if (!child.isNull()) {
+                        painter.drawImage(QRect(dx * tileSize / 2, dy * tileSize / 2, tileSize / 2, tileSize / 2), child);
+                    }
+                }
+                painter.end();
+            }
+            return image.save(QString("%1/%2_%3.png").arg(level_dir).arg(tile.x()).arg(tile.y()));
+        };
+        QList<bool> results = QtConcurrent::blockingMapped<QList<bool>>(tiles, write);
+        if (results.contains(false)) {
+            qDebug() << QString("Failed to write world atlas tiles to '%1'").arg(level_dir);
+            return false;
+        }
+        if (progress) {
+            progress(level + 1, max_level + 1);
+        }
+
+        // The parents of this level's tiles make up the next level.
+        QList<QPoint> parents;
+        QSet<quint64> parents_seen;
+        for (QPoint tile : tiles) {
+            QPoint parent(tile.x() / 2, tile.y() / 2);
+            quint64 key = (quint64(parent.x()) << 32) | quint32(parent.y());
+            if (!parents_seen.contains(key)) {
+                parents_seen.insert(key);
+                parents.append(parent);
+            }
+        }
+        tiles = parents;
+    }
+
+    QJsonArray maps;
+    for (Placement placement : placements) {
+        QJsonObject map;
+        map.insert("name", placement.map_name);
+        map.insert("x", placement.rect.x() * 16 - bounds.x());
+        map.insert("y", placement.rect.y() * 16 - bounds.y());
+        map.insert("width", placement.rect.width() * 16);
+        map.insert("height", placement.rect.height() * 16);
+        maps.append(map);
+    }
+    QJsonObject atlas;
+    atlas.insert("width", bounds.width());
+    atlas.insert("height", bounds.height());
+    atlas.insert("tile_size", tileSize);
+    atlas.insert("levels", max_level + 1);
+    atlas.insert("maps", maps);
+    QFile file(dir + "/atlas.json");
+    if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(atlas).toJson()) < 0) {
+        qDebug() << QString("Could not write '%1'").arg(file.fileName());
+        return false;
+    }
+    return true;
+}
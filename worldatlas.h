@@ -0,0 +1,57 @@
+#ifndef WORLDATLAS_H
+#define WORLDATLAS_H
+
+#include "project.h"
+
+#include <QString>
+#include <QList>
+#include <QRect>
+#include <QImage>
+#include <functional>
+
+// Lays out every map reachable through connections in one world, and renders
+// square tiles of it. Level 0 is full resolution, and each level after that
+// halves it, until the whole world fits in a single tile.
+//
+// Placements keep their own copy of each map's blocks, so tiles can be rendered
+// on any thread while the maps are being edited.
+class WorldAtlas
+{
+public:
+    class Placement {
+    public:
+        QString map_name;
+        QRect rect; // In metatiles.
+        QList<Block> blocks;
+        Tileset *tileset_primary = NULL;
+        Tileset *tileset_secondary = NULL;
+    };
+
+    WorldAtlas(Project *project);
+
+    static const int tileSize;
+
+    // Places start_map at the origin and every map connected to it around it.
+    // Without a start map, the largest group of connected maps is used. Only maps
+    // with connections are loaded to find it.
+    // Maps are loaded as needed, so this has to run on the GUI thread.
+    void build(QString start_map = QString());
+
+    QList<Placement> placements;
+    QRect bounds; // In pixels.
+    int maxLevel();
+    QRect tileRect(int level, int x, int y);
+    QImage renderTile(int level, int x, int y);
+    void replaceTilesets(QMap<Tileset*, Tileset*> tilesets);
+
+    // Writes the tile pyramid to <dir>/<level>/<x>_<y>.png, along with an atlas.json
+    // describing where each map was placed. Empty tiles are skipped.
+    bool exportTiles(QString dir, std::function<void(int, int)> progress = nullptr);
+
+private:
+    QList<Placement> placeMaps(QString start_map);
+
+    Project *project = NULL;
+};
+
+#endif // WORLDATLAS_H
@@ -0,0 +1,188 @@
+#include "worldview.h"
+
+#include <QtMath>
+#include <QThreadPool>
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
+
+WorldAtlasItem::WorldAtlasItem(WorldAtlas *atlas)
+{
+    this->atlas = atlas;
+    // In kilobytes. Each tile is 256 KB.
+    tiles.setMaxCost(64 * 1024);
+    // Otherwise exposedRect is always the whole atlas, and every repaint requests every tile.
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+}
+
+WorldAtlasItem::~WorldAtlasItem()
+{
+    cancel();
+}
+
+// Drops the tiles that haven't started rendering, and waits for the ones that have.
+void WorldAtlasItem::cancel() {
+    cancelled.storeRelease(1);
+    pool.clear();
+    pool.waitForDone();
+}
+
+// Renders everything again, e.g. once the atlas's tilesets were replaced.
+void WorldAtlasItem::restart() {
+    cancel();
+    // Tiles dropped by cancel() never finish, so they'd never leave pending otherwise.
+    pending.clear();
+    tiles.clear();
+    restarts++;
+    cancelled.storeRelease(0);
+    update();
+}
+
+QRectF WorldAtlasItem::boundingRect() const {
+    return QRectF(atlas->bounds);
+}
+
+void WorldAtlasItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *) {
+    // Use the smallest level that still has at least one pixel per screen pixel.
+    qreal detail = option->levelOfDetailFromTransform(painter->worldTransform());
+    int level = 0;
+    if (detail > 0 && detail < 1) {
+        level = qMin(int(qFloor(-qLn(detail) / qLn(2))), atlas->maxLevel());
+    }
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    if (level != last_level) {
+        last_level = level;
+        generation.ref();
+    }
+
+    int size = WorldAtlas::tileSize << level;
+    QRect exposed = option->exposedRect.toAlignedRect().intersected(atlas->bounds);
+    int first_x = (exposed.left() - atlas->bounds.left()) / size;
+    int last_x = (exposed.right() - atlas->bounds.left()) / size;
+    int first_y = (exposed.top() - atlas->bounds.top()) / size;
+    int last_y = (exposed.bottom() - atlas->bounds.top()) / size;
+    for (int y = first_y; y <= last_y; y++)
+    for (int x = first_x; x <= last_x; x++) {
+        QImage *tile = tiles.object(tileKey(level, x, y));
+        if (!tile) {
+            tile = composeTile(level, x, y);
+        }
+        if (tile) {
+            painter->drawImage(atlas->tileRect(level, x, y), *tile);
+            continue;
+        }
+        requestTile(level, x, y);
+
+        // Until it's ready, stretch the quarter of the next level's tile that covers it.
+        QImage *parent = tiles.object(tileKey(level + 1, x / 2, y / 2));
+        if (parent) {
+            int half = WorldAtlas::tileSize / 2;
+            painter->drawImage(atlas->tileRect(level, x, y), *parent, QRect((x % 2) * half, (y % 2) * half, half, half));
+        }
+    }
+}
+
+QString WorldAtlasItem::tileKey(int level, int x, int y) {
+    return QString("%1/%2/%3").arg(level).arg(x).arg(y);
+}
+
+// Builds a tile from the four tiles under it if they're all cached, like the
+// mipmaps of a map, instead of rendering it again.
+QImage *WorldAtlasItem::composeTile(int level, int x, int y) {
+    if (level == 0) {
+        return NULL;
+    }
+    QImage *children[4];
+    for (int i = 0; i < 4; i++) {
+        children[i] = tiles.object(tileKey(level - 1, x * 2 + i % 2, y * 2 + i / 2));
+        if (!children[i]) {
+            return NULL;
+        }
+    }
+    QImage *tile = new QImage(WorldAtlas::tileSize, WorldAtlas::tileSize, QImage::Format_ARGB32);
+    tile->fill(0);
+    QPainter painter(tile);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    int half = WorldAtlas::tileSize / 2;
+    for (int i = 0; i < 4; i++) {
+        painter.drawImage(QRect((i % 2) * half, (i / 2) * half, half, half), *children[i]);
+    }
+    painter.end();
+    tiles.insert(tileKey(level, x, y), tile, WorldAtlas::tileSize * WorldAtlas::tileSize * 4 / 1024);
+    return tiles.object(tileKey(level, x, y));
+}
+
+void WorldAtlasItem::requestTile(int level, int x, int y) {
+    QString key = tileKey(level, x, y);
+    if (pending.contains(key)) {
+        return;
+    }
+    pending.insert(key);
+
+    WorldAtlas *atlas = this->atlas;
+    QAtomicInt *generation = &this->generation;
+    QAtomicInt *cancelled = &this->cancelled;
+    int request_generation = generation->loadAcquire();
+    int request_restarts = restarts;
+    QFutureWatcher<QImage> *watcher = new QFutureWatcher<QImage>(this);
+    connect(watcher, &QFutureWatcher<QImage>::finished, [=]() {
+        watcher->deleteLater();
+        if (request_restarts != restarts) {
+            return;
+        }
+        pending.remove(key);
+        QImage image = watcher->result();
+        if (!image.isNull()) {
+            tiles.insert(key, new QImage(image), WorldAtlas::tileSize * WorldAtlas::tileSize * 4 / 1024);
+            update(atlas->tileRect(level, x, y));
+        }
+    });
+    watcher->setFuture(QtConcurrent::run(&pool, [atlas, generation, cancelled, request_generation, level, x, y]() {
+        if (cancelled->loadAcquire() || generation->loadAcquire() != request_generation) {
+            return QImage();
+        }
+        return atlas->renderTile(level, x, y);
+    }));
+}
+
+WorldView::WorldView(WorldAtlas *atlas, QWidget *parent) : QGraphicsView(parent)
+{
+    this->atlas = atlas;
+    scene = new QGraphicsScene(this);
+    item = new WorldAtlasItem(atlas);
+    scene->addItem(item);
+    scene->setSceneRect(atlas->bounds);
+    setScene(scene);
+    setDragMode(QGraphicsView::ScrollHandDrag);
+    setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+    setBackgroundBrush(Qt::darkGray);
+    setWindowFlags(Qt::Window);
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle("World Map");
+    resize(1024, 768);
+    fitInView(atlas->bounds, Qt::KeepAspectRatio);
+}
+
+WorldView::~WorldView()
+{
+    // Tiles still being rendered hold on to the atlas, so stop them first.
+    // The item uses the atlas too, so it goes with the scene before the atlas is deleted.
+    item->cancel();
+    delete scene;
+    delete atlas;
+}
+
+void WorldView::stopRendering() {
+    item->cancel();
+}
+
+void WorldView::replaceTilesets(QMap<Tileset*, Tileset*> tilesets) {
+    atlas->replaceTilesets(tilesets);
+    item->restart();
+}
+
+void WorldView::wheelEvent(QWheelEvent *event) {
+    qreal factor = qPow(1.25, event->angleDelta().y() / 120.0);
+    scale(factor, factor);
+}
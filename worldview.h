@@ -0,0 +1,65 @@
+#ifndef WORLDVIEW_H
+#define WORLDVIEW_H
+
+#include "worldatlas.h"
+
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsObject>
+#include <QWheelEvent>
+#include <QCache>
+#include <QSet>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+// Draws a world atlas one tile at a time, at the level that matches the current zoom.
+// Tiles are rendered in the background and drawn as they come in.
+class WorldAtlasItem : public QGraphicsObject
+{
+public:
+    WorldAtlasItem(WorldAtlas *atlas);
+    ~WorldAtlasItem();
+    QRectF boundingRect() const;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget);
+    void cancel();
+    void restart();
+
+private:
+    void requestTile(int level, int x, int y);
+    QImage *composeTile(int level, int x, int y);
+    static QString tileKey(int level, int x, int y);
+
+    WorldAtlas *atlas = NULL;
+    QCache<QString, QImage> tiles;
+    QSet<QString> pending;
+
+    // Tiles render on their own pool, so closing the view only waits for this view's work.
+    // Requests from an earlier zoom level are skipped once the level changes.
+    QThreadPool pool;
+    QAtomicInt generation;
+    QAtomicInt cancelled;
+    int last_level = -1;
+    // Tiles requested before the last restart are dropped when they come in.
+    int restarts = 0;
+};
+
+// A zoomable window onto the whole world.
+class WorldView : public QGraphicsView
+{
+    Q_OBJECT
+public:
+    WorldView(WorldAtlas *atlas, QWidget *parent = 0);
+    ~WorldView();
+    void stopRendering();
+    void replaceTilesets(QMap<Tileset*, Tileset*> tilesets);
+
+protected:
+    virtual void wheelEvent(QWheelEvent *event);
+
+private:
+    WorldAtlas *atlas = NULL;
+    QGraphicsScene *scene = NULL;
+    WorldAtlasItem *item = NULL;
+};
+
+#endif // WORLDVIEW_H